@@ -0,0 +1,213 @@
+// Buffered file input and int output shared by lab3-1, lab3-2 and lab3-3.
+// Every lab builds as a single translation unit, so definitions live here.
+#ifndef FAST_IO_H
+#define FAST_IO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Bytes of file read block and output buffer.
+#define IO_BUFFER_SIZE (1 << 20)
+
+// Characters of the longest int with sign and separator.
+#define MAX_INT_CHARS 12
+
+// Whole file contents, memory mapped or read into heap.
+typedef struct {
+    char* data;
+    size_t size;
+    int mapped;
+} FileBuffer;
+
+// Load file `path` by mmap, falling back to block read.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     File could not be opened or read.
+int load_file(FileBuffer* file, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            file->data = data;
+            file->size = st.st_size;
+            file->mapped = 1;
+            close(fd);
+            return 1;
+        }
+    }
+
+    // Block read for pipes or failed mapping.
+    size_t capacity = IO_BUFFER_SIZE;
+    file->data = malloc(capacity);
+    while (file->data != NULL) {
+        ssize_t n_read = read(fd, file->data + file->size, capacity - file->size);
+        if (n_read <= 0) {
+            break;
+        }
+        file->size += n_read;
+        if (file->size == capacity) {
+            capacity *= 2;
+            char* data = realloc(file->data, capacity);
+            if (data == NULL) {
+                free(file->data);
+            }
+            file->data = data;
+        }
+    }
+
+    close(fd);
+    return file->data != NULL;
+}
+
+// Release file contents.
+void unload_file(FileBuffer* file) {
+    if (file->mapped) {
+        munmap(file->data, file->size);
+    } else {
+        free(file->data);
+    }
+}
+
+// Cursor over whitespace separated tokens of a text buffer.
+typedef struct {
+    const char* cur;
+    const char* end;
+} Tokenizer;
+
+Tokenizer make_tokenizer(const char* data, size_t size) {
+    Tokenizer tokenizer;
+    tokenizer.cur = data;
+    tokenizer.end = data + size;
+    return tokenizer;
+}
+
+void skip_space(Tokenizer* tokenizer) {
+    while (tokenizer->cur < tokenizer->end && (unsigned char)*tokenizer->cur <= ' ') {
+        ++tokenizer->cur;
+    }
+}
+
+// Next token as "%s" of scanf, `token` points into the buffer.
+// Returns:
+//     length of token, 0 if no more token.
+int next_token(Tokenizer* tokenizer, const char** token) {
+    skip_space(tokenizer);
+    const char* begin = tokenizer->cur;
+    while (tokenizer->cur < tokenizer->end && (unsigned char)*tokenizer->cur > ' ') {
+        ++tokenizer->cur;
+    }
+    *token = begin;
+    return (int)(tokenizer->cur - begin);
+}
+
+// Parse int operand as "%d" of scanf.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     No digits ahead, cursor is left on the next token.
+int next_int(Tokenizer* tokenizer, int* res) {
+    skip_space(tokenizer);
+    const char* cur = tokenizer->cur;
+    const char* end = tokenizer->end;
+
+    int negative = cur < end && *cur == '-';
+    if (cur < end && (*cur == '-' || *cur == '+')) {
+        ++cur;
+    }
+    if (cur == end || (unsigned int)(*cur - '0') >= 10) {
+        return 0;
+    }
+
+    unsigned int value = 0;
+    unsigned int digit;
+    while (cur < end && (digit = (unsigned char)*cur - '0') < 10) {
+        value = value * 10 + digit;
+        ++cur;
+    }
+
+    tokenizer->cur = cur;
+    *res = negative ? (int)(0u - value) : (int)value;
+    return 1;
+}
+
+// Output accumulated in one buffer and written by blocks.
+typedef struct {
+    FILE* fp;
+    int size;
+    char buffer[IO_BUFFER_SIZE];
+} OutputBuffer;
+
+// Two-digit table for int formatting.
+const char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Write buffered contents to file.
+void flush_output(OutputBuffer* output) {
+    fwrite(output->buffer, 1, output->size, output->fp);
+    output->size = 0;
+}
+
+// Write `length` bytes of `text`, shorter than IO_BUFFER_SIZE.
+void write_text(OutputBuffer* output, const char* text, int length) {
+    if (output->size + length > IO_BUFFER_SIZE) {
+        flush_output(output);
+    }
+    memcpy(output->buffer + output->size, text, length);
+    output->size += length;
+}
+
+// Write `value` followed by `sep` in the same format as "%d%c".
+void write_int(OutputBuffer* output, int value, char sep) {
+    if (output->size + MAX_INT_CHARS > IO_BUFFER_SIZE) {
+        flush_output(output);
+    }
+
+    char* out = output->buffer + output->size;
+    unsigned int abs = value;
+    if (value < 0) {
+        *out++ = '-';
+        abs = 0u - abs;
+    }
+
+    // Fill digits backward, two at a time.
+    char digits[MAX_INT_CHARS];
+    char* ptr = digits + MAX_INT_CHARS;
+    while (abs >= 100) {
+        unsigned int pair = (abs % 100) * 2;
+        abs /= 100;
+        *--ptr = DIGIT_PAIRS[pair + 1];
+        *--ptr = DIGIT_PAIRS[pair];
+    }
+    if (abs >= 10) {
+        *--ptr = DIGIT_PAIRS[abs * 2 + 1];
+        *--ptr = DIGIT_PAIRS[abs * 2];
+    } else {
+        *--ptr = '0' + abs;
+    }
+
+    int len = digits + MAX_INT_CHARS - ptr;
+    memcpy(out, ptr, len);
+    out[len] = sep;
+    output->size = out + len + 1 - output->buffer;
+}
+
+#endif // FAST_IO_H
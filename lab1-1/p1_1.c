@@ -1,52 +1,1235 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-int numeric_limit_int_max() {
-    return 1 << (sizeof(int) * 8 - 2);
+#include "../tasks.h"
+
+// Partitions not larger than this are sorted by sorting network.
+// Networks sit under introsort only, radix sort takes any input of
+// RADIX_THRESHOLD ints or more and never reaches them.
+#define SMALL_SORT_THRESHOLD 32
+
+// SIMD sorting networks are built with GCC vector extensions on x86.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SORT_NETWORK_SIMD
+#endif
+
+// Number of int lanes in a network vector.
+#define NETWORK_LANES 8
+
+// Arrays not smaller than this are sorted by radix sort.
+#define RADIX_THRESHOLD 256
+
+// Number of bits per radix digit.
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_PASSES (sizeof(int) * 8 / RADIX_BITS)
+
+// Upper bound of sorting threads.
+#define MAX_THREADS 256
+
+// Buffer size of block read fallback and buffered writer.
+#define IO_BUFFER_SIZE (1 << 16)
+
+// Longest decimal int with sign and separator.
+#define MAX_INT_CHARS 12
+
+// Default memory budget of external sort in MiB.
+#define DEFAULT_MEMORY_MB 256
+
+// Upper bound of runs merged at once by external sort.
+#define MAX_MERGE_FANIN 128
+
+void swap(int* a, int* b) {
+    int tmp = *a;
+    *a = *b;
+    *b = tmp;
 }
 
-void selection_sort(int* arr, int size) {
+// Sort `arr[0, size)` by insertion sort.
+void insertion_sort(int* arr, int size) {
     int i, j;
+    for (i = 1; i < size; ++i) {
+        int key = arr[i];
+        for (j = i; j > 0 && arr[j - 1] > key; --j) {
+            arr[j] = arr[j - 1];
+        }
+        arr[j] = key;
+    }
+}
+
+// Kernel sorting one block of 8, 16 or 32 ints.
+typedef void (*BlockSort)(int* arr, int size);
+
+// Scalar kernel, the reference for SIMD kernels.
+void scalar_block_sort(int* arr, int size) {
+    insertion_sort(arr, size);
+}
+
+#ifdef SORT_NETWORK_SIMD
+typedef int v8si __attribute__((vector_size(NETWORK_LANES * sizeof(int))));
+
+// Compare-exchange lanes of `a` and `b`, `a` keeps minimums.
+static inline __attribute__((always_inline)) void vec_minmax(v8si* a, v8si* b) {
+    v8si m = *a < *b;
+    v8si lo = (*a & m) | (*b & ~m);
+    v8si hi = (*b & m) | (*a & ~m);
+    *a = lo;
+    *b = hi;
+}
+
+// Lane permutations exchanging lane `i` with lane `i ^ j`.
+static const v8si PERM_XOR1 = { 1, 0, 3, 2, 5, 4, 7, 6 };
+static const v8si PERM_XOR2 = { 2, 3, 0, 1, 6, 7, 4, 5 };
+static const v8si PERM_XOR4 = { 4, 5, 6, 7, 0, 1, 2, 3 };
+static const v8si PERM_REVERSE = { 7, 6, 5, 4, 3, 2, 1, 0 };
+
+// Lanes keeping the minimum on bitonic stage `k`, step `j`.
+static const v8si MIN_K2_J1 = { -1, 0, 0, -1, -1, 0, 0, -1 };
+static const v8si MIN_K4_J2 = { -1, -1, 0, 0, 0, 0, -1, -1 };
+static const v8si MIN_K4_J1 = { -1, 0, -1, 0, 0, -1, 0, -1 };
+static const v8si MIN_K8_J4 = { -1, -1, -1, -1, 0, 0, 0, 0 };
+static const v8si MIN_K8_J2 = { -1, -1, 0, 0, -1, -1, 0, 0 };
+static const v8si MIN_K8_J1 = { -1, 0, -1, 0, -1, 0, -1, 0 };
+
+// One bitonic step inside a vector, lane `i` exchanges with lane `perm[i]`
+// and keeps the minimum where `take_min[i]` is set.
+static inline __attribute__((always_inline)) void vec_step(
+        v8si* v, const v8si* perm, const v8si* take_min) {
+    v8si p = __builtin_shuffle(*v, *perm);
+    v8si lo = *v;
+    vec_minmax(&lo, &p);
+    *v = (lo & *take_min) | (p & ~*take_min);
+}
+
+// Sort lanes of `v` by full bitonic network.
+static inline __attribute__((always_inline)) void vec_sort(v8si* v) {
+    vec_step(v, &PERM_XOR1, &MIN_K2_J1);
+    vec_step(v, &PERM_XOR2, &MIN_K4_J2);
+    vec_step(v, &PERM_XOR1, &MIN_K4_J1);
+    vec_step(v, &PERM_XOR4, &MIN_K8_J4);
+    vec_step(v, &PERM_XOR2, &MIN_K8_J2);
+    vec_step(v, &PERM_XOR1, &MIN_K8_J1);
+}
+
+// Sort lanes of bitonic `v` by half cleaners.
+static inline __attribute__((always_inline)) void vec_clean(v8si* v) {
+    vec_step(v, &PERM_XOR4, &MIN_K8_J4);
+    vec_step(v, &PERM_XOR2, &MIN_K8_J2);
+    vec_step(v, &PERM_XOR1, &MIN_K8_J1);
+}
+
+// Reverse lanes of `v`.
+static inline __attribute__((always_inline)) void vec_reverse(v8si* v) {
+    *v = __builtin_shuffle(*v, PERM_REVERSE);
+}
+
+// Bitonic merge of sorted `v[0, n_vec / 2)` and `v[n_vec / 2, n_vec)`.
+// Reversing the upper half makes the whole sequence bitonic.
+static inline __attribute__((always_inline)) void vec_merge(v8si* v, int n_vec) {
+    int i;
+    int half = n_vec / 2;
+    for (i = 0; i < half / 2; ++i) {
+        v8si tmp = v[half + i];
+        v[half + i] = v[n_vec - 1 - i];
+        v[n_vec - 1 - i] = tmp;
+    }
+    for (i = half; i < n_vec; ++i) {
+        vec_reverse(&v[i]);
+    }
+
+    // Half cleaners across vectors, then inside each vector.
+    int dist;
+    for (dist = half; dist > 0; dist /= 2) {
+        for (i = 0; i < n_vec; ++i) {
+            if ((i & dist) == 0) {
+                vec_minmax(&v[i], &v[i + dist]);
+            }
+        }
+    }
+    for (i = 0; i < n_vec; ++i) {
+        vec_clean(&v[i]);
+    }
+}
+
+// Sort block of `size` ints, `size` is 8, 16 or 32.
+static inline __attribute__((always_inline)) void vec_block_sort(int* arr, int size) {
+    int i;
+    v8si v[SMALL_SORT_THRESHOLD / NETWORK_LANES];
+    int n_vec = size / NETWORK_LANES;
+
+    memcpy(v, arr, sizeof(int) * size);
+    for (i = 0; i < n_vec; ++i) {
+        vec_sort(&v[i]);
+    }
+    if (n_vec >= 2) {
+        vec_merge(v, 2);
+    }
+    if (n_vec >= 4) {
+        vec_merge(v + 2, 2);
+        vec_merge(v, 4);
+    }
+    memcpy(arr, v, sizeof(int) * size);
+}
+
+__attribute__((target("avx2"))) void avx2_block_sort(int* arr, int size) {
+    vec_block_sort(arr, size);
+}
+
+__attribute__((target("sse4.1"))) void sse41_block_sort(int* arr, int size) {
+    vec_block_sort(arr, size);
+}
+#endif
+
+// Named block sort kernel.
+// Kernels with `automatic` unset are used only when requested by name.
+typedef struct {
+    const char* name;
+    BlockSort kernel;
+    int automatic;
+} BlockSortKernel;
+
+// Kernels in order of preference.
+// SSE4.1 splits every 8-lane vector in two and measures on par with scalar,
+// so it is not picked automatically.
+BlockSortKernel block_sort_kernels[] = {
+#ifdef SORT_NETWORK_SIMD
+    { "avx2", avx2_block_sort, 1 },
+    { "sse4.1", sse41_block_sort, 0 },
+#endif
+    { "scalar", scalar_block_sort, 1 },
+};
+
+#define N_BLOCK_SORT_KERNELS \
+    ((int)(sizeof(block_sort_kernels) / sizeof(BlockSortKernel)))
+
+// Kernel used for small partitions.
+BlockSort block_sort = scalar_block_sort;
+
+// Validate if CPU supports kernel `name`.
+int block_sort_supported(const char* name) {
+#ifdef SORT_NETWORK_SIMD
+    __builtin_cpu_init();
+    if (!strcmp(name, "avx2")) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (!strcmp(name, "sse4.1")) {
+        return __builtin_cpu_supports("sse4.1");
+    }
+#endif
+    return !strcmp(name, "scalar");
+}
+
+// Select kernel `name`, or best supported one if `name` is NULL.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Unknown or unsupported kernel.
+int select_block_sort(const char* name) {
+    int i;
+    for (i = 0; i < N_BLOCK_SORT_KERNELS; ++i) {
+        if ((name == NULL ? block_sort_kernels[i].automatic
+                          : !strcmp(name, block_sort_kernels[i].name))
+            && block_sort_supported(block_sort_kernels[i].name)) {
+            block_sort = block_sort_kernels[i].kernel;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Sort `arr[0, size)` for `size` not larger than `SMALL_SORT_THRESHOLD`.
+// Input is padded with INT_MAX up to the kernel block size.
+// Reached from `comparison_sort` only: input below RADIX_THRESHOLD,
+// splitter samples of `parallel_sort`, or radix buffer allocation failure.
+void small_sort(int* arr, int size) {
+    if (size < 2 || block_sort == scalar_block_sort) {
+        insertion_sort(arr, size);
+        return;
+    }
+
+    int i;
+    int block = NETWORK_LANES;
+    int buffer[SMALL_SORT_THRESHOLD];
+    while (block < size) {
+        block *= 2;
+    }
+
+    memcpy(buffer, arr, sizeof(int) * size);
+    for (i = size; i < block; ++i) {
+        buffer[i] = INT_MAX;
+    }
+    block_sort(buffer, block);
+    memcpy(arr, buffer, sizeof(int) * size);
+}
+
+// Compare every supported kernel against scalar one on `n_trial` random blocks.
+// Returns:
+//     number of mismatched kernels.
+int verify_block_sort(int n_trial, FILE* output) {
+    int i, j, k;
+    int n_fail = 0;
+    int block[SMALL_SORT_THRESHOLD];
+    int expected[SMALL_SORT_THRESHOLD];
+
+    for (k = 0; k < N_BLOCK_SORT_KERNELS; ++k) {
+        BlockSortKernel* kernel = &block_sort_kernels[k];
+        if (!block_sort_supported(kernel->name)) {
+            fprintf(output, "%s : unsupported\n", kernel->name);
+            continue;
+        }
+
+        int fail = 0;
+        srand(k + 1);
+        for (i = 0; i < n_trial && !fail; ++i) {
+            int size = NETWORK_LANES << (rand() % 3);
+            for (j = 0; j < size; ++j) {
+                // Mix narrow range for duplicates and extreme values.
+                switch (rand() % 4) {
+                case 0:
+                    block[j] = rand() % 4;
+                    break;
+                case 1:
+                    block[j] = rand() % 2 ? INT_MAX : INT_MIN;
+                    break;
+                default:
+                    block[j] = (int)((unsigned int)rand() << 16 ^ (unsigned int)rand());
+                    break;
+                }
+            }
+            memcpy(expected, block, sizeof(int) * size);
+            scalar_block_sort(expected, size);
+            kernel->kernel(block, size);
+            fail = memcmp(expected, block, sizeof(int) * size) != 0;
+        }
+
+        fprintf(output, "%s : %s\n", kernel->name, fail ? "mismatch" : "ok");
+        n_fail += fail;
+    }
+
+    return n_fail;
+}
+
+// Restore max-heap property of `arr[0, size)` from the root `idx`.
+void sift_down(int* arr, int idx, int size) {
+    int key = arr[idx];
+    int child;
+    while ((child = 2 * idx + 1) < size) {
+        if (child + 1 < size && arr[child] < arr[child + 1]) {
+            ++child;
+        }
+        if (arr[child] <= key) {
+            break;
+        }
+        arr[idx] = arr[child];
+        idx = child;
+    }
+    arr[idx] = key;
+}
+
+// Sort `arr[0, size)` by heap sort.
+void heap_sort(int* arr, int size) {
+    int i;
+    for (i = size / 2 - 1; i >= 0; --i) {
+        sift_down(arr, i, size);
+    }
+    for (i = size - 1; i > 0; --i) {
+        swap(&arr[0], &arr[i]);
+        sift_down(arr, 0, i);
+    }
+}
+
+// Move median of `arr[0]`, `arr[size / 2]`, `arr[size - 1]` to `arr[0]`.
+void median_of_three(int* arr, int size) {
+    int* a = &arr[size / 2];
+    int* b = &arr[0];
+    int* c = &arr[size - 1];
+
+    if (*a > *c) {
+        swap(a, c);
+    }
+    if (*b > *c) {
+        swap(b, c);
+    }
+    if (*a > *b) {
+        swap(a, b);
+    }
+}
+
+// Sort `arr[0, size)` by quick sort,
+// falling back to heap sort after `depth` levels of bad partitions.
+void intro_sort(int* arr, int size, int depth) {
+    while (size > SMALL_SORT_THRESHOLD) {
+        if (depth-- == 0) {
+            heap_sort(arr, size);
+            return;
+        }
+
+        // Hoare partition around the median of three.
+        median_of_three(arr, size);
+        int pivot = arr[0];
+        int i = 0;
+        int j = size;
+        while (1) {
+            while (arr[++i] < pivot && i < size - 1);
+            while (arr[--j] > pivot);
+            if (i >= j) {
+                break;
+            }
+            swap(&arr[i], &arr[j]);
+        }
+        swap(&arr[0], &arr[j]);
+
+        // Recurse into smaller half, iterate on larger one.
+        if (j < size - j - 1) {
+            intro_sort(arr, j, depth);
+            arr += j + 1;
+            size -= j + 1;
+        } else {
+            intro_sort(arr + j + 1, size - j - 1, depth);
+            size = j;
+        }
+    }
+    small_sort(arr, size);
+}
+
+// Sort `arr[0, size)` by comparison, with O(n log n) worst case.
+void comparison_sort(int* arr, int size) {
+    int depth = 0;
+    int n;
+    for (n = size; n > 1; n >>= 1) {
+        ++depth;
+    }
+    intro_sort(arr, size, 2 * depth);
+}
+
+// Map int to unsigned int preserving order.
+unsigned int radix_key(int value) {
+    return (unsigned int)value ^ 0x80000000u;
+}
+
+// Sort `arr[0, size)` by LSD radix sort.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Memory allocation for temporary buffer failed.
+int radix_sort(int* arr, int size) {
+    int count[RADIX_PASSES][RADIX_SIZE];
+    int* buffer = malloc(sizeof(int) * size);
+    if (buffer == NULL) {
+        return 0;
+    }
+
+    int i;
+    unsigned int pass;
+    memset(count, 0, sizeof(count));
+
+    // Histogram for every digit in one sweep.
     for (i = 0; i < size; ++i) {
-        int idx = -1;
-        int min = numeric_limit_int_max();
-        for (j = i; j < size; ++j) {
-            if (min > arr[j]) {
-                min = arr[j];
-                idx = j;
+        unsigned int key = radix_key(arr[i]);
+        for (pass = 0; pass < RADIX_PASSES; ++pass) {
+            ++count[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)];
+        }
+    }
+
+    int* src = arr;
+    int* dst = buffer;
+    for (pass = 0; pass < RADIX_PASSES; ++pass) {
+        int* hist = count[pass];
+        int shift = pass * RADIX_BITS;
+
+        // Skip pass if every element shares the same digit.
+        if (hist[(radix_key(src[0]) >> shift) & (RADIX_SIZE - 1)] == size) {
+            continue;
+        }
+
+        // Exclusive prefix sum for bucket offset.
+        int sum = 0;
+        for (i = 0; i < RADIX_SIZE; ++i) {
+            int tmp = hist[i];
+            hist[i] = sum;
+            sum += tmp;
+        }
+
+        for (i = 0; i < size; ++i) {
+            dst[hist[(radix_key(src[i]) >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+        }
+
+        int* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != arr) {
+        memcpy(arr, src, sizeof(int) * size);
+    }
+
+    free(buffer);
+    return 1;
+}
+
+// Sort `arr[0, size)` in ascending order.
+// Radix sort for large input, introsort for small input or allocation failure.
+// Introsort with network leaves loses to radix sort from about 512 ints,
+// so the threshold stays low and block kernels do not matter for large input.
+void selection_sort(int* arr, int size) {
+    if (size < 2) {
+        return;
+    }
+    if (size >= RADIX_THRESHOLD && radix_sort(arr, size)) {
+        return;
+    }
+    comparison_sort(arr, size);
+}
+
+// Loser tree for k-way merge of sorted sources.
+// `tree[0]` holds the index of the winner (smallest key),
+// `tree[1, k)` hold the losers of each internal match.
+typedef struct {
+    int k;
+    int* tree;
+    int* keys;
+    char* done;
+} LoserTree;
+
+// Generate loser tree for `k` sources.
+// Keys should be filled before `build_loser_tree`.
+LoserTree make_loser_tree(int k) {
+    LoserTree lt;
+    lt.k = k;
+    lt.tree = malloc(sizeof(int) * k);
+    lt.keys = malloc(sizeof(int) * k);
+    lt.done = calloc(k, sizeof(char));
+    return lt;
+}
+
+// Delete loser tree.
+void delete_loser_tree(LoserTree* lt) {
+    free(lt->tree);
+    free(lt->keys);
+    free(lt->done);
+}
+
+// Compare current keys of two sources, exhausted source is the largest.
+// Ties are broken by source index for stability.
+int loser_less(LoserTree* lt, int a, int b) {
+    if (lt->done[a]) {
+        return 0;
+    }
+    if (lt->done[b]) {
+        return 1;
+    }
+    return lt->keys[a] < lt->keys[b] || (lt->keys[a] == lt->keys[b] && a < b);
+}
+
+// Play matches of subtree `node` and return the winner.
+int play_loser_tree(LoserTree* lt, int node) {
+    if (node >= lt->k) {
+        return node - lt->k;
+    }
+    int left = play_loser_tree(lt, 2 * node);
+    int right = play_loser_tree(lt, 2 * node + 1);
+    if (loser_less(lt, left, right)) {
+        lt->tree[node] = right;
+        return left;
+    }
+    lt->tree[node] = left;
+    return right;
+}
+
+// Build tree from current keys.
+void build_loser_tree(LoserTree* lt) {
+    lt->tree[0] = play_loser_tree(lt, 1);
+}
+
+// Replay matches from source `src` to the root after its key changed.
+void replay_loser_tree(LoserTree* lt, int src) {
+    int winner = src;
+    int node = (src + lt->k) / 2;
+    for (; node >= 1; node /= 2) {
+        if (loser_less(lt, lt->tree[node], winner)) {
+            int tmp = lt->tree[node];
+            lt->tree[node] = winner;
+            winner = tmp;
+        }
+    }
+    lt->tree[0] = winner;
+}
+
+// Merge `k` sorted runs `runs[i][0, lens[i])` into `out`.
+void merge_runs(int** runs, int* lens, int k, int* out) {
+    int i;
+    int* pos = calloc(k, sizeof(int));
+    LoserTree lt = make_loser_tree(k);
+    for (i = 0; i < k; ++i) {
+        lt.done[i] = lens[i] == 0;
+        lt.keys[i] = lens[i] > 0 ? runs[i][0] : 0;
+    }
+    build_loser_tree(&lt);
+
+    int src;
+    while (!lt.done[src = lt.tree[0]]) {
+        *out++ = lt.keys[src];
+        if (++pos[src] < lens[src]) {
+            lt.keys[src] = runs[src][pos[src]];
+        } else {
+            lt.done[src] = 1;
+        }
+        replay_loser_tree(&lt, src);
+    }
+
+    delete_loser_tree(&lt);
+    free(pos);
+}
+
+// Task for sorting one chunk or merging one output range.
+typedef struct {
+    int* arr;
+    int size;
+
+    int k;
+    int** runs;
+    int* lens;
+    int* out;
+} SortTask;
+
+void* sort_chunk_task(void* arg) {
+    SortTask* task = arg;
+    selection_sort(task->arr, task->size);
+    return NULL;
+}
+
+void* merge_range_task(void* arg) {
+    SortTask* task = arg;
+    merge_runs(task->runs, task->lens, task->k, task->out);
+    return NULL;
+}
+
+// First index of `arr[0, size)` not less than `value`.
+int lower_bound(int* arr, int size, int value) {
+    int lo = 0;
+    int hi = size;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (arr[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Sort `arr[0, size)` with `n_thread` threads.
+// Each thread sorts its own chunk, then sorted chunks are cut by sampled
+// splitters and every thread merges the pieces of one value range.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Memory allocation for merge buffer failed.
+int parallel_sort(int* arr, int size, int n_thread) {
+    int i, j;
+    if (n_thread > MAX_THREADS) {
+        n_thread = MAX_THREADS;
+    }
+    if (n_thread > size / RADIX_THRESHOLD) {
+        n_thread = size / RADIX_THRESHOLD;
+    }
+    if (n_thread <= 1 || pthread_create == NULL) {
+        selection_sort(arr, size);
+        return 1;
+    }
+
+    int* buffer = malloc(sizeof(int) * size);
+    int* samples = malloc(sizeof(int) * n_thread * n_thread);
+    // bounds[t * n_thread + c]: start of value range `t` in chunk `c`.
+    int* bounds = malloc(sizeof(int) * (n_thread + 1) * n_thread);
+    int** runs = malloc(sizeof(int*) * n_thread * n_thread);
+    int* lens = malloc(sizeof(int) * n_thread * n_thread);
+    SortTask* tasks = malloc(sizeof(SortTask) * n_thread);
+    if (!buffer || !samples || !bounds || !runs || !lens || !tasks) {
+        free(buffer);
+        free(samples);
+        free(bounds);
+        free(runs);
+        free(lens);
+        free(tasks);
+        return 0;
+    }
+
+    // Sort chunks locally.
+    for (i = 0; i < n_thread; ++i) {
+        int start = (int)((long long)size * i / n_thread);
+        int end = (int)((long long)size * (i + 1) / n_thread);
+        tasks[i].arr = arr + start;
+        tasks[i].size = end - start;
+    }
+    run_tasks(sort_chunk_task, tasks, sizeof(SortTask), n_thread);
+
+    // Regular sampling for splitters.
+    for (i = 0; i < n_thread; ++i) {
+        for (j = 0; j < n_thread; ++j) {
+            samples[i * n_thread + j] =
+                tasks[i].arr[(int)((long long)tasks[i].size * (j + 1) / (n_thread + 1))];
+        }
+    }
+    comparison_sort(samples, n_thread * n_thread);
+
+    // Cut every chunk by splitters.
+    for (j = 0; j < n_thread; ++j) {
+        bounds[j] = 0;
+        bounds[n_thread * n_thread + j] = tasks[j].size;
+    }
+    for (i = 1; i < n_thread; ++i) {
+        int splitter = samples[i * n_thread];
+        for (j = 0; j < n_thread; ++j) {
+            bounds[i * n_thread + j] = lower_bound(tasks[j].arr, tasks[j].size, splitter);
+        }
+    }
+
+    // Merge each value range into its offset of buffer.
+    int offset = 0;
+    for (i = 0; i < n_thread; ++i) {
+        tasks[i].k = n_thread;
+        tasks[i].runs = runs + i * n_thread;
+        tasks[i].lens = lens + i * n_thread;
+        tasks[i].out = buffer + offset;
+        for (j = 0; j < n_thread; ++j) {
+            int lo = bounds[i * n_thread + j];
+            int hi = bounds[(i + 1) * n_thread + j];
+            tasks[i].runs[j] = arr + (int)((long long)size * j / n_thread) + lo;
+            tasks[i].lens[j] = hi - lo;
+            offset += hi - lo;
+        }
+    }
+    run_tasks(merge_range_task, tasks, sizeof(SortTask), n_thread);
+
+    memcpy(arr, buffer, sizeof(int) * size);
+
+    free(buffer);
+    free(samples);
+    free(bounds);
+    free(runs);
+    free(lens);
+    free(tasks);
+    return 1;
+}
+
+// Whole file contents, memory mapped or read into heap.
+typedef struct {
+    char* data;
+    size_t size;
+    int mapped;
+} FileBuffer;
+
+// Load file `path` by mmap, falling back to block read.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     File could not be opened or read.
+int load_file(FileBuffer* file, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            file->data = data;
+            file->size = st.st_size;
+            file->mapped = 1;
+            close(fd);
+            return 1;
+        }
+    }
+
+    // Block read for pipes or failed mapping.
+    size_t capacity = IO_BUFFER_SIZE;
+    file->data = malloc(capacity);
+    while (file->data != NULL) {
+        ssize_t n_read = read(fd, file->data + file->size, capacity - file->size);
+        if (n_read <= 0) {
+            break;
+        }
+        file->size += n_read;
+        if (file->size == capacity) {
+            capacity *= 2;
+            char* data = realloc(file->data, capacity);
+            if (data == NULL) {
+                free(file->data);
             }
+            file->data = data;
         }
+    }
+
+    close(fd);
+    return file->data != NULL;
+}
 
-        int tmp = arr[i];
-        arr[i] = arr[idx];
-        arr[idx] = tmp;
+// Release file contents.
+void unload_file(FileBuffer* file) {
+    if (file->mapped) {
+        munmap(file->data, file->size);
+    } else {
+        free(file->data);
     }
 }
 
-int main() {
-    FILE* fp = fopen("input.txt", "r");
+// Cursor over decimal ints in a text buffer.
+typedef struct {
+    const char* cur;
+    const char* end;
+} IntParser;
 
-    int n_input = 0;
-    fscanf(fp, "%d", &n_input);
+IntParser make_int_parser(const char* data, size_t size) {
+    IntParser parser;
+    parser.cur = data;
+    parser.end = data + size;
+    return parser;
+}
 
+// Validate if all 8 bytes of `chunk` are ASCII digits.
+int swar_all_digits(unsigned long long chunk) {
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ull)
+            | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+        == 0x3333333333333333ull;
+}
+
+// Convert 8 ASCII digits, first digit in the lowest byte, to its value.
+unsigned int swar_parse_8(unsigned long long chunk) {
+    chunk = ((chunk & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+    chunk = ((chunk & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+    return (unsigned int)(((chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32);
+}
+
+// Parse next int from `parser` to `res`.
+// Eight digits are converted at once on little-endian targets.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     No more int in buffer.
+int parse_int(IntParser* parser, int* res) {
+    const char* cur = parser->cur;
+    const char* end = parser->end;
+    while (cur < end && (unsigned char)*cur <= ' ') {
+        ++cur;
+    }
+    if (cur == end) {
+        parser->cur = cur;
+        return 0;
+    }
+
+    int negative = *cur == '-';
+    if (*cur == '-' || *cur == '+') {
+        ++cur;
+    }
+
+    unsigned int value = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    unsigned long long chunk;
+    if (end - cur >= 8) {
+        memcpy(&chunk, cur, sizeof(chunk));
+        if (swar_all_digits(chunk)) {
+            value = swar_parse_8(chunk);
+            cur += 8;
+        }
+    }
+#endif
+    unsigned int digit;
+    while (cur < end && (digit = (unsigned char)*cur - '0') < 10) {
+        value = value * 10 + digit;
+        ++cur;
+    }
+
+    parser->cur = cur;
+    *res = negative ? (int)(0u - value) : (int)value;
+    return 1;
+}
+
+// Buffered writer for decimal ints.
+typedef struct {
+    FILE* fp;
+    int size;
+    char buffer[IO_BUFFER_SIZE];
+} IntWriter;
+
+// Two-digit table for int formatting.
+const char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Write buffered contents to file.
+void flush_writer(IntWriter* writer) {
+    fwrite(writer->buffer, 1, writer->size, writer->fp);
+    writer->size = 0;
+}
+
+// Write `value` followed by `sep` in the same format as "%d%c".
+void write_int(IntWriter* writer, int value, char sep) {
+    if (writer->size + MAX_INT_CHARS > IO_BUFFER_SIZE) {
+        flush_writer(writer);
+    }
+
+    char* out = writer->buffer + writer->size;
+    unsigned int abs = value;
+    if (value < 0) {
+        *out++ = '-';
+        abs = 0u - abs;
+    }
+
+    // Fill digits backward, two at a time.
+    char digits[MAX_INT_CHARS];
+    char* ptr = digits + MAX_INT_CHARS;
+    while (abs >= 100) {
+        unsigned int pair = (abs % 100) * 2;
+        abs /= 100;
+        *--ptr = DIGIT_PAIRS[pair + 1];
+        *--ptr = DIGIT_PAIRS[pair];
+    }
+    if (abs >= 10) {
+        *--ptr = DIGIT_PAIRS[abs * 2 + 1];
+        *--ptr = DIGIT_PAIRS[abs * 2];
+    } else {
+        *--ptr = '0' + abs;
+    }
+
+    int len = digits + MAX_INT_CHARS - ptr;
+    memcpy(out, ptr, len);
+    out[len] = sep;
+    writer->size = out + len + 1 - writer->buffer;
+}
+
+// Write single character.
+void write_char(IntWriter* writer, char c) {
+    if (writer->size + 1 > IO_BUFFER_SIZE) {
+        flush_writer(writer);
+    }
+    writer->buffer[writer->size++] = c;
+}
+
+// Sort `arr[0, size)` with `n_thread` threads.
+void sort_ints(int* arr, int size, int n_thread) {
+    if (n_thread <= 1 || !parallel_sort(arr, size, n_thread)) {
+        selection_sort(arr, size);
+    }
+}
+
+// Create anonymous temporary file in `dir`.
+// File is unlinked at once and vanishes when closed.
+// Returns:
+//     NULL, if file could not be created
+//     FILE*, if otherwise
+FILE* make_temp_file(const char* dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/p1_1.XXXXXX", dir);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+
+    FILE* fp = fdopen(fd, "w+b");
+    if (fp == NULL) {
+        close(fd);
+    }
+    return fp;
+}
+
+// Buffered reader over a binary run of ints.
+typedef struct {
+    FILE* fp;
+    int* buffer;
+    int capacity;
+    int size;
+    int pos;
+} RunReader;
+
+// Read next int of `reader` to `res`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Run is exhausted.
+int read_run(RunReader* reader, int* res) {
+    if (reader->pos == reader->size) {
+        reader->size = fread(reader->buffer, sizeof(int), reader->capacity, reader->fp);
+        reader->pos = 0;
+        if (reader->size == 0) {
+            return 0;
+        }
+    }
+    *res = reader->buffer[reader->pos++];
+    return 1;
+}
+
+// Merge binary runs `runs[0, k)` through loser tree.
+// Merged ints go to binary file `binary` if given, otherwise to text `writer`.
+// `buffer[0, buffer_size)` is shared among run readers and binary output.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Readers could not be allocated or write to output failed.
+int merge_files(FILE** runs, int k, int* buffer, size_t buffer_size,
+                FILE* binary, IntWriter* writer) {
     int i;
-    int* arr = malloc(sizeof(int) * n_input);
-    for (i = 0; i < n_input; ++i) {
-        fscanf(fp, "%d", &arr[i]);
+    int chunk = buffer_size / (k + 1);
+    int* out = buffer + (size_t)chunk * k;
+    int n_out = 0;
+    int ok = 1;
+
+    RunReader* readers = malloc(sizeof(RunReader) * k);
+    LoserTree lt = make_loser_tree(k);
+    if (readers == NULL || lt.tree == NULL || lt.keys == NULL || lt.done == NULL) {
+        delete_loser_tree(&lt);
+        free(readers);
+        return 0;
+    }
+    for (i = 0; i < k; ++i) {
+        rewind(runs[i]);
+        readers[i].fp = runs[i];
+        readers[i].buffer = buffer + (size_t)chunk * i;
+        readers[i].capacity = chunk;
+        readers[i].size = 0;
+        readers[i].pos = 0;
+        lt.done[i] = !read_run(&readers[i], &lt.keys[i]);
     }
+    build_loser_tree(&lt);
 
-    fclose(fp);
+    int src;
+    while (!lt.done[src = lt.tree[0]]) {
+        if (binary == NULL) {
+            write_int(writer, lt.keys[src], ' ');
+        } else {
+            out[n_out++] = lt.keys[src];
+            if (n_out == chunk) {
+                ok &= fwrite(out, sizeof(int), n_out, binary) == (size_t)n_out;
+                n_out = 0;
+            }
+        }
+        lt.done[src] = !read_run(&readers[src], &lt.keys[src]);
+        replay_loser_tree(&lt, src);
+    }
+    if (binary != NULL) {
+        ok &= fwrite(out, sizeof(int), n_out, binary) == (size_t)n_out;
+        ok &= fflush(binary) == 0;
+    }
 
-    selection_sort(arr, n_input);
+    delete_loser_tree(&lt);
+    free(readers);
+    return ok;
+}
 
-    fp = fopen("output.txt", "w");
-    for (i = 0; i < n_input; ++i) {
-        fprintf(fp, "%d ", arr[i]);
+// Sort `n_input` ints from `parser` within `memory_mb` MiB and write text to `writer`.
+// Sorted runs are spilled to temporary files in `dir`,
+// then merged by at most `MAX_MERGE_FANIN` runs per pass.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Memory budget could not be allocated or temporary file I/O failed.
+int external_sort(IntParser* parser, int n_input, int n_thread,
+                  int memory_mb, const char* dir, IntWriter* writer) {
+    int i;
+    // Half of budget is kept for radix or merge scratch of in-memory sort.
+    size_t buffer_size = (size_t)memory_mb * (1 << 20) / sizeof(int);
+    int run_size = buffer_size / 2 < INT_MAX ? buffer_size / 2 : INT_MAX;
+    if (run_size <= MAX_MERGE_FANIN) {
+        return 0;
+    }
+
+    int* buffer = malloc(sizeof(int) * (size_t)run_size);
+    if (buffer == NULL) {
+        return 0;
     }
-    fprintf(fp, "\n");
 
-    fclose(fp);
+    // Generate sorted runs.
+    int n_run = 0;
+    int capacity = MAX_MERGE_FANIN;
+    FILE** runs = malloc(sizeof(FILE*) * capacity);
+    int ok = runs != NULL;
+    int n_read = 0;
+    while (ok && n_read < n_input) {
+        int size;
+        for (size = 0; size < run_size && n_read < n_input
+                       && parse_int(parser, &buffer[size]); ++size, ++n_read);
+        if (size == 0) {
+            break;
+        }
+        sort_ints(buffer, size, n_thread);
+
+        if (n_run == capacity) {
+            FILE** grown = realloc(runs, sizeof(FILE*) * capacity * 2);
+            if (grown == NULL) {
+                ok = 0;
+                break;
+            }
+            runs = grown;
+            capacity *= 2;
+        }
+        runs[n_run] = make_temp_file(dir);
+        ok = runs[n_run] != NULL
+            && fwrite(buffer, sizeof(int), size, runs[n_run]) == (size_t)size
+            && fflush(runs[n_run]) == 0;
+        if (runs[n_run] != NULL) {
+            ++n_run;
+        }
+    }
+
+    // Merge passes until runs fit in single fan-in.
+    while (ok && n_run > MAX_MERGE_FANIN) {
+        int n_merged = 0;
+        for (i = 0; ok && i < n_run; i += MAX_MERGE_FANIN) {
+            int k = n_run - i < MAX_MERGE_FANIN ? n_run - i : MAX_MERGE_FANIN;
+            FILE* merged = make_temp_file(dir);
+            ok = merged != NULL
+                && merge_files(runs + i, k, buffer, run_size, merged, NULL);
+
+            int j;
+            for (j = i; j < i + k; ++j) {
+                fclose(runs[j]);
+                runs[j] = NULL;
+            }
+            runs[n_merged++] = merged;
+        }
+        // Close runs left by failed pass.
+        for (; i < n_run; ++i) {
+            fclose(runs[i]);
+        }
+        n_run = n_merged;
+    }
+
+    if (ok && n_run > 0) {
+        ok = merge_files(runs, n_run, buffer, run_size, NULL, writer);
+    }
+
+    for (i = 0; i < n_run; ++i) {
+        if (runs[i] != NULL) {
+            fclose(runs[i]);
+        }
+    }
+    free(runs);
+    free(buffer);
+    return ok;
+}
+
+// Options for sorting.
+typedef struct {
+    int n_thread;
+    const char* kernel;
+    int n_verify;
+    int memory_mb;
+    const char* temp_dir;
+} SortOption;
+
+// Parse command line options.
+// Usage:
+//     -t <n>: sort with `n` threads, default 1.
+//     -k <avx2|sse4.1|scalar>: small block kernel, default best supported.
+//                              Used below RADIX_THRESHOLD ints only.
+//     -verify <n>: compare kernels against scalar on `n` random blocks and exit.
+//     -m <mb>: memory budget in MiB, input not fitting in it is sorted externally.
+//     -d <dir>: directory for temporary runs of external sort, default /tmp.
+SortOption parse_option(int argc, char* argv[]) {
+    SortOption option;
+    option.n_thread = 1;
+    option.kernel = NULL;
+    option.n_verify = 0;
+    option.memory_mb = 0;
+    option.temp_dir = "/tmp";
+
+    int i;
+    for (i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            option.n_thread = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-k") && i + 1 < argc) {
+            option.kernel = argv[++i];
+        } else if (!strcmp(argv[i], "-verify") && i + 1 < argc) {
+            option.n_verify = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            option.memory_mb = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            option.temp_dir = argv[++i];
+        }
+    }
+
+    return option;
+}
+
+int main(int argc, char* argv[]) {
+    SortOption option = parse_option(argc, argv);
+    if (option.n_verify > 0) {
+        return verify_block_sort(option.n_verify, stdout) != 0;
+    }
+    if (!select_block_sort(option.kernel)) {
+        fprintf(stderr, "unsupported kernel %s\n", option.kernel);
+        return 1;
+    }
+
+    FileBuffer file;
+    if (!load_file(&file, "input.txt")) {
+        return 1;
+    }
+    IntParser parser = make_int_parser(file.data, file.size);
+
+    int n_input = 0;
+    parse_int(&parser, &n_input);
+
+    IntWriter* writer = malloc(sizeof(IntWriter));
+    writer->fp = fopen("output.txt", "w");
+    writer->size = 0;
+
+    // Sort in memory, or externally if input exceeds budget or allocation fails.
+    int i;
+    int* arr = NULL;
+    size_t required = sizeof(int) * (size_t)n_input * 2;
+    if (option.memory_mb <= 0 || required <= (size_t)option.memory_mb * (1 << 20)) {
+        arr = malloc(sizeof(int) * (size_t)n_input);
+    }
+
+    int ok = 1;
+    if (arr != NULL) {
+        for (i = 0; i < n_input && parse_int(&parser, &arr[i]); ++i);
+        n_input = i;
+
+        sort_ints(arr, n_input, option.n_thread);
+        for (i = 0; i < n_input; ++i) {
+            write_int(writer, arr[i], ' ');
+        }
+    } else {
+        int memory_mb = option.memory_mb > 0 ? option.memory_mb : DEFAULT_MEMORY_MB;
+        ok = external_sort(&parser, n_input, option.n_thread,
+                           memory_mb, option.temp_dir, writer);
+    }
+    write_char(writer, '\n');
+    flush_writer(writer);
+
+    fclose(writer->fp);
+    unload_file(&file);
+    free(writer);
     free(arr);
 
+    if (!ok) {
+        fprintf(stderr, "external sort failed\n");
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "../tasks.h"
+
+// Initial bytes reserved in string arena per record.
+#define ARENA_BYTES_PER_RECORD 24
+
+// Number of iovec per writev call.
+#define MAX_IOV 1024
+
+// Longest decimal int with sign.
+#define MAX_INT_CHARS 12
+
+// Magic bytes of binary record file.
+#define BINARY_MAGIC "STUDENT1"
+
+// Upper bound of ingest and sort threads.
+#define MAX_THREADS 256
 
 typedef struct {
     char* name;
@@ -8,35 +30,1247 @@ typedef struct {
     char* major;
 } studentT;
 
-int main(int argc, char* argv[]) {
-    FILE* fp = fopen("input.txt", "r");
-    
-    int i;
+// Slice of string arena.
+typedef struct {
+    int offset;
+    int length;
+} StringRef;
+
+// Columnar store of student records.
+// IDs live in a contiguous column, names and majors are NUL-terminated
+// strings in one arena referenced by offset and length.
+typedef struct {
+    int size;
+    int capacity;
+    int* ids;
+    StringRef* names;
+    StringRef* majors;
+
+    char* arena;
+    size_t arena_size;
+    size_t arena_capacity;
+} StudentStore;
+
+// Generate empty store.
+StudentStore make_store() {
+    StudentStore store;
+    memset(&store, 0, sizeof(store));
+    return store;
+}
+
+// Delete all records and storage of `store` at once.
+void delete_store(StudentStore* store) {
+    free(store->ids);
+    free(store->names);
+    free(store->majors);
+    free(store->arena);
+    *store = make_store();
+}
+
+// Reserve columns for `capacity` records and arena for `arena_capacity` bytes.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Memory allocation failed.
+int reserve_store(StudentStore* store, int capacity, size_t arena_capacity) {
+    if (capacity > store->capacity) {
+        int* ids = realloc(store->ids, sizeof(int) * capacity);
+        if (ids == NULL) {
+            return 0;
+        }
+        store->ids = ids;
+
+        StringRef* names = realloc(store->names, sizeof(StringRef) * capacity);
+        if (names == NULL) {
+            return 0;
+        }
+        store->names = names;
+
+        StringRef* majors = realloc(store->majors, sizeof(StringRef) * capacity);
+        if (majors == NULL) {
+            return 0;
+        }
+        store->majors = majors;
+        store->capacity = capacity;
+    }
+
+    if (arena_capacity > store->arena_capacity) {
+        char* arena = realloc(store->arena, arena_capacity);
+        if (arena == NULL) {
+            return 0;
+        }
+        store->arena = arena;
+        store->arena_capacity = arena_capacity;
+    }
+
+    return 1;
+}
+
+// Append one byte to arena, growing it geometrically.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Memory allocation failed.
+int arena_putc(StudentStore* store, char c) {
+    if (store->arena_size == store->arena_capacity
+        && !reserve_store(store, 0, store->arena_capacity * 2 + ARENA_BYTES_PER_RECORD)) {
+        return 0;
+    }
+    store->arena[store->arena_size++] = c;
+    return 1;
+}
+
+// Skip whitespace of `fp`.
+// Returns:
+//     first non-whitespace character, or EOF.
+int skip_space(FILE* fp) {
+    int c;
+    while ((c = getc(fp)) != EOF && (unsigned char)c <= ' ');
+    return c;
+}
+
+// Read whitespace-separated token of `fp` into arena as NUL-terminated string.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     End of file or memory allocation failed.
+int read_token(StudentStore* store, FILE* fp, StringRef* ref) {
+    int c = skip_space(fp);
+    if (c == EOF) {
+        return 0;
+    }
+
+    ref->offset = store->arena_size;
+    do {
+        if (!arena_putc(store, c)) {
+            return 0;
+        }
+    } while ((c = getc(fp)) != EOF && (unsigned char)c > ' ');
+
+    ref->length = store->arena_size - ref->offset;
+    return arena_putc(store, 0);
+}
+
+// Read decimal int of `fp` to `res`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     End of file or no digit.
+int read_int(FILE* fp, int* res) {
+    int c = skip_space(fp);
+    int negative = c == '-';
+    if (negative) {
+        c = getc(fp);
+    }
+
+    unsigned int value = 0;
+    unsigned int digit;
+    int n_digit = 0;
+    while (c != EOF && (digit = (unsigned int)c - '0') < 10) {
+        value = value * 10 + digit;
+        ++n_digit;
+        c = getc(fp);
+    }
+
+    *res = negative ? (int)(0u - value) : (int)value;
+    return n_digit > 0;
+}
+
+// Load records of `fp` into `store` in a single pass.
+// Format:
+//     <n>
+//     <name> <studentID> <major>, n times
+// Returns:
+//     number of loaded records.
+int load_store(StudentStore* store, FILE* fp) {
     int n_input = 0;
-    fscanf(fp, "%d", &n_input);
+    if (!read_int(fp, &n_input) || n_input < 0
+        || !reserve_store(store, store->size + n_input,
+                          store->arena_size + (size_t)n_input * ARENA_BYTES_PER_RECORD)) {
+        return 0;
+    }
 
-    studentT* arr = malloc(sizeof(studentT) * n_input);
+    int i;
     for (i = 0; i < n_input; ++i) {
-        arr[i].name = malloc(sizeof(char) * 31);
-        arr[i].major = malloc(sizeof(char) * 31);
+        int idx = store->size;
+        if (!read_token(store, fp, &store->names[idx])
+            || !read_int(fp, &store->ids[idx])
+            || !read_token(store, fp, &store->majors[idx])) {
+            break;
+        }
+        ++store->size;
+    }
+
+    return i;
+}
+
+// View of record `idx`, strings point into arena.
+// Views are invalidated when arena grows.
+studentT get_student(StudentStore* store, int idx) {
+    studentT student;
+    student.name = store->arena + store->names[idx].offset;
+    student.studentID = store->ids[idx];
+    student.major = store->arena + store->majors[idx].offset;
+    return student;
+}
+
+// Read-only memory mapping of whole file.
+typedef struct {
+    const char* data;
+    size_t size;
+} MappedFile;
+
+// Map file `path` into memory.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     File could not be opened, is not a regular file or mapping failed.
+int map_file(MappedFile* file, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    int ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+    if (ok) {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ok = data != MAP_FAILED;
+        if (ok) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            file->data = data;
+            file->size = st.st_size;
+        }
+    }
+
+    close(fd);
+    return ok;
+}
+
+// Unmap file.
+void unmap_file(MappedFile* file) {
+    munmap((void*)file->data, file->size);
+}
+
+// Slice of mapped input.
+typedef struct {
+    const char* ptr;
+    int length;
+} StringView;
+
+// Zero-copy view of one record in mapped input.
+// `id_text` is empty if id is not written as "%d" prints it.
+// `line` covers the whole record if it is exactly "<name> <id> <major>\n"
+// with canonical id, so it can be written back as is, and is empty otherwise.
+typedef struct {
+    StringView name;
+    StringView id_text;
+    StringView major;
+    StringView line;
+    int studentID;
+} StudentView;
+
+// Cursor over mapped input.
+typedef struct {
+    const char* cur;
+    const char* end;
+} Scanner;
+
+// Next whitespace-separated token of `scanner`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     End of input.
+int scan_token(Scanner* scanner, StringView* view) {
+    const char* cur = scanner->cur;
+    const char* end = scanner->end;
+    while (cur < end && (unsigned char)*cur <= ' ') {
+        ++cur;
+    }
+
+    view->ptr = cur;
+    while (cur < end && (unsigned char)*cur > ' ') {
+        ++cur;
+    }
+    view->length = cur - view->ptr;
+
+    scanner->cur = cur;
+    return view->length > 0;
+}
+
+// Parse decimal int `view` to `res`.
+// Returns:
+//     1 if `view` is written exactly as "%d" prints `res`.
+//     0 if otherwise, e.g. sign or leading zeros.
+int parse_view_int(StringView view, int* res) {
+    const char* ptr = view.ptr;
+    const char* end = ptr + view.length;
+    int negative = ptr < end && *ptr == '-';
+    int canonical = ptr < end && *ptr != '+';
+    if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+        ++ptr;
+    }
+
+    // Leading zeros and "-0" are printed differently.
+    canonical = canonical && ptr < end
+        && (*ptr != '0' || (end - ptr == 1 && !negative));
 
-        fscanf(fp, "%s %d %s", arr[i].name, &arr[i].studentID, arr[i].major);
+    unsigned int value = 0;
+    unsigned int digit;
+    while (ptr < end && (digit = (unsigned char)*ptr - '0') < 10) {
+        value = value * 10 + digit;
+        ++ptr;
     }
 
+    *res = negative ? (int)(0u - value) : (int)value;
+    return canonical && ptr == end;
+}
+
+// Parse next record of `scanner` into `view`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     End of input before all three fields.
+int parse_record(Scanner* scanner, StudentView* view) {
+    if (!scan_token(scanner, &view->name)
+        || !scan_token(scanner, &view->id_text)
+        || !scan_token(scanner, &view->major)) {
+        return 0;
+    }
+
+    const char* line_end = view->major.ptr + view->major.length;
+
+    // Exact record has single spaces between fields and newline at the end.
+    view->line.ptr = view->name.ptr;
+    view->line.length = 0;
+    if (line_end < scanner->end && *line_end == '\n'
+        && view->id_text.ptr == view->name.ptr + view->name.length + 1
+        && view->name.ptr[view->name.length] == ' '
+        && view->major.ptr == view->id_text.ptr + view->id_text.length + 1
+        && view->id_text.ptr[view->id_text.length] == ' ') {
+        view->line.length = line_end + 1 - view->name.ptr;
+    }
+    if (!parse_view_int(view->id_text, &view->studentID)) {
+        view->id_text.length = 0;
+        view->line.length = 0;
+    }
+
+    return 1;
+}
+
+// Scan record count of mapped input, leaving `scanner` at the first record.
+// Returns:
+//     record count, or 0 if missing.
+int parse_header(const MappedFile* file, Scanner* scanner) {
+    scanner->cur = file->data;
+    scanner->end = file->data + file->size;
+
+    int n_input = 0;
+    StringView token;
+    if (scan_token(scanner, &token)) {
+        parse_view_int(token, &n_input);
+    }
+    return n_input > 0 ? n_input : 0;
+}
+
+// Parse records of mapped input into `views` without copying fields.
+// Format is the same as `load_store`.
+// Returns:
+//     number of parsed records, `*views` should be freed by caller.
+int parse_views(const MappedFile* file, StudentView** views) {
+    Scanner scanner;
+    int n_input = parse_header(file, &scanner);
+    *views = NULL;
+    if (n_input == 0 || (*views = malloc(sizeof(StudentView) * n_input)) == NULL) {
+        return 0;
+    }
+
+    int i;
+    for (i = 0; i < n_input && parse_record(&scanner, &(*views)[i]); ++i);
+    return i;
+}
+
+// Batch of output slices for writev.
+typedef struct {
+    int fd;
+    int ok;
+    int size;
+    struct iovec iov[MAX_IOV];
+    // Scratch for ids not printable from input.
+    int n_scratch;
+    char scratch[MAX_IOV][MAX_INT_CHARS];
+} IovWriter;
+
+// Write all slices in batch, retrying partial writes.
+void flush_iov(IovWriter* writer) {
+    struct iovec* iov = writer->iov;
+    int size = writer->size;
+    while (writer->ok && size > 0) {
+        ssize_t written = writev(writer->fd, iov, size);
+        if (written < 0) {
+            writer->ok = 0;
+            break;
+        }
+        // Skip fully written slices, then trim partial one.
+        while (size > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --size;
+        }
+        if (size > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    writer->size = 0;
+    writer->n_scratch = 0;
+}
+
+// Append slice to batch, merging it with previous slice if adjacent in memory.
+void push_iov(IovWriter* writer, const char* ptr, size_t length) {
+    if (writer->size > 0) {
+        struct iovec* last = &writer->iov[writer->size - 1];
+        if ((const char*)last->iov_base + last->iov_len == ptr) {
+            last->iov_len += length;
+            return;
+        }
+    }
+    if (writer->size == MAX_IOV) {
+        flush_iov(writer);
+    }
+    writer->iov[writer->size].iov_base = (void*)ptr;
+    writer->iov[writer->size].iov_len = length;
+    ++writer->size;
+}
+
+// Write record `view` as "%s %d %s\n".
+// Exact records are written straight from the mapping,
+// consecutive ones collapse into a single slice.
+void write_view(IovWriter* writer, const StudentView* view) {
+    if (view->line.length > 0) {
+        push_iov(writer, view->line.ptr, view->line.length);
+        return;
+    }
+
+    // Reserve room for separators and id scratch.
+    if (writer->size + 6 > MAX_IOV || writer->n_scratch == MAX_IOV) {
+        flush_iov(writer);
+    }
+
+    push_iov(writer, view->name.ptr, view->name.length);
+    push_iov(writer, " ", 1);
+    if (view->id_text.length > 0) {
+        push_iov(writer, view->id_text.ptr, view->id_text.length);
+    } else {
+        char* id = writer->scratch[writer->n_scratch++];
+        push_iov(writer, id, snprintf(id, MAX_INT_CHARS, "%d", view->studentID));
+    }
+    push_iov(writer, " ", 1);
+    push_iov(writer, view->major.ptr, view->major.length);
+    push_iov(writer, "\n", 1);
+}
+
+// Open writev batch over file `path`.
+IovWriter* open_iov_writer(const char* path) {
+    IovWriter* writer = malloc(sizeof(IovWriter));
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    writer->ok = writer->fd >= 0;
+    writer->size = 0;
+    writer->n_scratch = 0;
+    return writer;
+}
+
+// Flush and close writer.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     File could not be opened or written.
+int close_iov_writer(IovWriter* writer) {
+    flush_iov(writer);
+
+    int ok = writer->ok;
+    if (writer->fd >= 0) {
+        ok = close(writer->fd) == 0 && ok;
+    }
+    free(writer);
+    return ok;
+}
+
+// Write records of mapped `input` to file `path` without copying fields.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Output file could not be written.
+int pass_through(const MappedFile* input, const char* path) {
+    StudentView* views;
+    int n_view = parse_views(input, &views);
+
+    IovWriter* writer = open_iov_writer(path);
+
+    int i;
+    for (i = 0; i < n_view; ++i) {
+        write_view(writer, &views[i]);
+    }
+
+    free(views);
+    return close_iov_writer(writer);
+}
+
+// Header of binary record file.
+// Layout:
+//     BinaryHeader
+//     int ids[n_record], in record order
+//     StringRef names[n_record], majors[n_record], into heap
+//     int index[n_record], record indices sorted by id
+//     char heap[heap_size], NUL-terminated strings
+typedef struct {
+    char magic[8];
+    int n_record;
+    int reserved;
+    long long heap_size;
+} BinaryHeader;
+
+// Pair of sort key and record index.
+typedef struct {
+    int key;
+    int idx;
+} KeyIndex;
+
+// Compare by key, then by index for stable order.
+int compare_key_index(const void* lhs, const void* rhs) {
+    const KeyIndex* a = lhs;
+    const KeyIndex* b = rhs;
+    if (a->key != b->key) {
+        return a->key < b->key ? -1 : 1;
+    }
+    return (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+// Write `store` to binary file `path`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Memory allocation or file write failed.
+int write_binary(StudentStore* store, const char* path) {
+    int i;
+    int n = store->size;
+    KeyIndex* pairs = malloc(sizeof(KeyIndex) * (n > 0 ? n : 1));
+    int* index = malloc(sizeof(int) * (n > 0 ? n : 1));
+    FILE* fp = fopen(path, "wb");
+    int ok = pairs != NULL && index != NULL && fp != NULL;
+
+    if (ok) {
+        for (i = 0; i < n; ++i) {
+            pairs[i].key = store->ids[i];
+            pairs[i].idx = i;
+        }
+        qsort(pairs, n, sizeof(KeyIndex), compare_key_index);
+        for (i = 0; i < n; ++i) {
+            index[i] = pairs[i].idx;
+        }
+
+        BinaryHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+        header.n_record = n;
+        header.heap_size = store->arena_size;
+
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1
+            && fwrite(store->ids, sizeof(int), n, fp) == (size_t)n
+            && fwrite(store->names, sizeof(StringRef), n, fp) == (size_t)n
+            && fwrite(store->majors, sizeof(StringRef), n, fp) == (size_t)n
+            && fwrite(index, sizeof(int), n, fp) == (size_t)n
+            && fwrite(store->arena, 1, store->arena_size, fp) == store->arena_size;
+    }
+
+    if (fp != NULL) {
+        ok = fclose(fp) == 0 && ok;
+    }
+    free(pairs);
+    free(index);
+    return ok;
+}
+
+// Memory-mapped binary record file, columns point into mapping.
+typedef struct {
+    MappedFile file;
+    int n_record;
+    const int* ids;
+    const StringRef* names;
+    const StringRef* majors;
+    const int* index;
+    const char* heap;
+    long long heap_size;
+} BinaryStore;
+
+// Validate if `ref` is a NUL-terminated string inside heap of `store`.
+int valid_string_ref(const BinaryStore* store, StringRef ref) {
+    return ref.offset >= 0 && ref.length >= 0
+        && (long long)ref.offset + ref.length < store->heap_size
+        && store->heap[ref.offset + ref.length] == '\0';
+}
+
+// Validate if record `idx` exists and its strings lie inside heap of `store`.
+int valid_record(const BinaryStore* store, int idx) {
+    return idx >= 0 && idx < store->n_record
+        && valid_string_ref(store, store->names[idx])
+        && valid_string_ref(store, store->majors[idx]);
+}
+
+// Map binary file `path` without loading records.
+// Only header and size are checked, entries are checked when they are read.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     File could not be mapped or is not a valid binary record file.
+int open_binary(BinaryStore* store, const char* path) {
+    if (!map_file(&store->file, path)) {
+        return 0;
+    }
+
+    const BinaryHeader* header = (const BinaryHeader*)store->file.data;
+    size_t size = store->file.size;
+    if (size < sizeof(BinaryHeader)
+        || memcmp(header->magic, BINARY_MAGIC, sizeof(header->magic))
+        || header->n_record < 0 || header->heap_size < 0
+        || size != sizeof(BinaryHeader) + (size_t)header->heap_size
+                   + (size_t)header->n_record * (sizeof(int) * 2 + sizeof(StringRef) * 2)) {
+        unmap_file(&store->file);
+        return 0;
+    }
+
+    int n = header->n_record;
+    store->n_record = n;
+    store->ids = (const int*)(header + 1);
+    store->names = (const StringRef*)(store->ids + n);
+    store->majors = store->names + n;
+    store->index = (const int*)(store->majors + n);
+    store->heap = (const char*)(store->index + n);
+    store->heap_size = header->heap_size;
+    return 1;
+}
+
+// Unmap binary file.
+void close_binary(BinaryStore* store) {
+    unmap_file(&store->file);
+}
+
+// View of record `idx`, strings point into read-only mapping.
+// Condition:
+//     `valid_record(store, idx)`.
+studentT get_binary_student(BinaryStore* store, int idx) {
+    studentT student;
+    student.name = (char*)store->heap + store->names[idx].offset;
+    student.studentID = store->ids[idx];
+    student.major = (char*)store->heap + store->majors[idx].offset;
+    return student;
+}
+
+// Find record with `id` by binary search over sorted index.
+// Only index entries and record on the search path are read and checked.
+// Returns:
+//     1 if record is found.
+//     0 if no record has `id`.
+//     -1 if an entry on the search path is invalid.
+int find_binary(BinaryStore* store, int id, studentT* res) {
+    int lo = 0;
+    int hi = store->n_record;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int idx = store->index[mid];
+        if (idx < 0 || idx >= store->n_record) {
+            return -1;
+        }
+        if (store->ids[idx] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == store->n_record || store->ids[store->index[lo]] != id) {
+        return 0;
+    }
+    if (!valid_record(store, store->index[lo])) {
+        return -1;
+    }
+    *res = get_binary_student(store, store->index[lo]);
+    return 1;
+}
+
+// Convert text records `input` to binary file `output`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+int text_to_binary(const char* input, const char* output) {
+    FILE* fp = fopen(input, "r");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    StudentStore store = make_store();
+    load_store(&store, fp);
     fclose(fp);
 
-    fp = fopen("output.txt", "w");
-    for (i = 0; i < n_input; ++i) {
-        fprintf(fp, "%s %d %s\n", arr[i].name, arr[i].studentID, arr[i].major);
+    int ok = write_binary(&store, output);
+    delete_store(&store);
+    return ok;
+}
+
+// Convert binary file `input` to text records `output`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+int binary_to_text(const char* input, const char* output) {
+    BinaryStore store;
+    if (!open_binary(&store, input)) {
+        return 0;
+    }
+
+    IovWriter* writer = open_iov_writer(output);
+    char count[MAX_INT_CHARS + 1];
+    push_iov(writer, count, snprintf(count, sizeof(count), "%d\n", store.n_record));
+
+    int i;
+    int valid = 1;
+    for (i = 0; i < store.n_record; ++i) {
+        if (!valid_record(&store, i)) {
+            valid = 0;
+            break;
+        }
+        StudentView view;
+        view.name.ptr = store.heap + store.names[i].offset;
+        view.name.length = store.names[i].length;
+        view.major.ptr = store.heap + store.majors[i].offset;
+        view.major.length = store.majors[i].length;
+        view.id_text.length = 0;
+        view.line.length = 0;
+        view.studentID = store.ids[i];
+        write_view(writer, &view);
+    }
+
+    int ok = close_iov_writer(writer) && valid;
+    close_binary(&store);
+    return ok;
+}
+
+// Task for parsing one chunk of mapped input.
+// Chunks are cut at whitespace, records may span them.
+typedef struct {
+    Scanner scanner;
+    const char* input_end;
+    int n_token;
+    int skip;
+    StudentView* views;
+    int size;
+} ParseTask;
+
+// Count tokens of chunk.
+void* count_chunk_task(void* arg) {
+    ParseTask* task = arg;
+    Scanner scanner = task->scanner;
+    StringView token;
+
+    task->n_token = 0;
+    while (scan_token(&scanner, &token)) {
+        ++task->n_token;
+    }
+    return NULL;
+}
+
+// Parse records starting in chunk, after `skip` tokens ending a record of previous chunk.
+// Last record may read past the chunk up to end of input.
+void* parse_chunk_task(void* arg) {
+    ParseTask* task = arg;
+    const char* chunk_end = task->scanner.end;
+    Scanner scanner = task->scanner;
+    StringView token;
+    int i;
+
+    scanner.end = task->input_end;
+    for (i = 0; i < task->skip; ++i) {
+        scan_token(&scanner, &token);
+    }
+
+    int capacity = task->n_token / 3 + 1;
+    task->size = 0;
+    task->views = malloc(sizeof(StudentView) * capacity);
+    while (task->views != NULL && task->size < capacity) {
+        while (scanner.cur < chunk_end && (unsigned char)*scanner.cur <= ' ') {
+            ++scanner.cur;
+        }
+        if (scanner.cur >= chunk_end || !parse_record(&scanner, &task->views[task->size])) {
+            break;
+        }
+        ++task->size;
+    }
+    return NULL;
+}
+// Parse records of mapped input with `n_thread` threads.
+// Input is cut at whitespace and tokens of every chunk are counted first,
+// so each chunk knows where its first record starts whatever separates fields.
+// Returns:
+//     number of parsed records, `*views` should be freed by caller.
+int parallel_parse_views(const MappedFile* file, StudentView** views, int n_thread) {
+    Scanner scanner;
+    int n_input = parse_header(file, &scanner);
+    *views = NULL;
+    if (n_thread <= 1 || n_input == 0) {
+        return parse_views(file, views);
+    }
+    if (n_thread > MAX_THREADS) {
+        n_thread = MAX_THREADS;
+    }
+
+    int i;
+    ParseTask tasks[MAX_THREADS];
+    const char* begin = scanner.cur;
+    size_t length = scanner.end - begin;
+    for (i = 0; i < n_thread; ++i) {
+        const char* cut = begin + length * (i + 1) / n_thread;
+        while (cut < scanner.end && (unsigned char)*cut > ' ') {
+            ++cut;
+        }
+        tasks[i].scanner.cur = i == 0 ? begin : tasks[i - 1].scanner.end;
+        tasks[i].scanner.end = cut > tasks[i].scanner.cur ? cut : tasks[i].scanner.cur;
+        tasks[i].input_end = scanner.end;
     }
+    run_tasks(count_chunk_task, tasks, sizeof(ParseTask), n_thread);
 
+    // Tokens before a chunk tell how many of its first ones end previous record.
+    long n_token = 0;
+    for (i = 0; i < n_thread; ++i) {
+        tasks[i].skip = (int)((3 - n_token % 3) % 3);
+        n_token += tasks[i].n_token;
+    }
+    run_tasks(parse_chunk_task, tasks, sizeof(ParseTask), n_thread);
+
+    // Concatenate chunks in order, up to the record count of header.
+    int size = 0;
+    *views = malloc(sizeof(StudentView) * n_input);
+    for (i = 0; i < n_thread; ++i) {
+        int n_copy = tasks[i].size < n_input - size ? tasks[i].size : n_input - size;
+        if (*views != NULL && n_copy > 0) {
+            memcpy(*views + size, tasks[i].views, sizeof(StudentView) * n_copy);
+            size += n_copy;
+        }
+        free(tasks[i].views);
+    }
+    return *views != NULL ? size : 0;
+}
+
+// Compare views as strcmp does.
+int compare_view(StringView a, StringView b) {
+    int length = a.length < b.length ? a.length : b.length;
+    int res = memcmp(a.ptr, b.ptr, length);
+    if (res != 0) {
+        return res;
+    }
+    return (a.length > b.length) - (a.length < b.length);
+}
+
+int compare_view_ptr(const void* lhs, const void* rhs) {
+    return compare_view(*(const StringView*)lhs, *(const StringView*)rhs);
+}
+
+// FNV-1a hash of view.
+unsigned int hash_view(StringView view) {
+    int i;
+    unsigned int hash = 2166136261u;
+    for (i = 0; i < view.length; ++i) {
+        hash = (hash ^ (unsigned char)view.ptr[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Assign every record the lexicographic rank of its major.
+// Distinct majors are collected by open addressing hash table and sorted.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Memory allocation failed.
+int rank_majors(StudentView* views, int n_view, int* ranks) {
+    int i;
+    int capacity = 16;
+    while (capacity < n_view * 2) {
+        capacity *= 2;
+    }
+
+    // Slot holds distinct major index + 1, 0 for empty.
+    int* slots = calloc(capacity, sizeof(int));
+    StringView* majors = malloc(sizeof(StringView) * (n_view > 0 ? n_view : 1));
+    int* major_rank = malloc(sizeof(int) * (n_view > 0 ? n_view : 1));
+    int ok = slots != NULL && majors != NULL && major_rank != NULL;
+
+    int n_major = 0;
+    for (i = 0; ok && i < n_view; ++i) {
+        unsigned int slot = hash_view(views[i].major) & (capacity - 1);
+        while (slots[slot] != 0
+               && compare_view(majors[slots[slot] - 1], views[i].major) != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (slots[slot] == 0) {
+            majors[n_major++] = views[i].major;
+            slots[slot] = n_major;
+        }
+        ranks[i] = slots[slot] - 1;
+    }
+
+    // Sort copy of distinct majors, then map first-seen index to rank.
+    StringView* sorted = ok ? malloc(sizeof(StringView) * (n_major > 0 ? n_major : 1)) : NULL;
+    ok = sorted != NULL;
+    if (ok) {
+        memcpy(sorted, majors, sizeof(StringView) * n_major);
+        qsort(sorted, n_major, sizeof(StringView), compare_view_ptr);
+        for (i = 0; i < n_major; ++i) {
+            unsigned int slot = hash_view(sorted[i]) & (capacity - 1);
+            while (compare_view(majors[slots[slot] - 1], sorted[i]) != 0) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            major_rank[slots[slot] - 1] = i;
+        }
+        for (i = 0; i < n_view; ++i) {
+            ranks[i] = major_rank[ranks[i]];
+        }
+    }
+
+    free(slots);
+    free(majors);
+    free(sorted);
+    free(major_rank);
+    return ok;
+}
+
+// Compact sort key of record: major rank in upper half, biased id in lower half.
+typedef struct {
+    unsigned long long key;
+    int idx;
+} SortKey;
+
+// Compare by key, then by record index so equal records keep input order.
+int compare_sort_key(const void* lhs, const void* rhs) {
+    const SortKey* a = lhs;
+    const SortKey* b = rhs;
+    if (a->key != b->key) {
+        return a->key < b->key ? -1 : 1;
+    }
+    return (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+// Task for sorting one run or merging two adjacent runs.
+typedef struct {
+    SortKey* src;
+    SortKey* dst;
+    int begin;
+    int mid;
+    int end;
+} SortTask;
+
+void* sort_run_task(void* arg) {
+    SortTask* task = arg;
+    qsort(task->src + task->begin, task->end - task->begin,
+          sizeof(SortKey), compare_sort_key);
+    return NULL;
+}
+
+void* merge_run_task(void* arg) {
+    SortTask* task = arg;
+    int i = task->begin;
+    int j = task->mid;
+    int k = task->begin;
+    while (i < task->mid && j < task->end) {
+        if (compare_sort_key(&task->src[j], &task->src[i]) < 0) {
+            task->dst[k++] = task->src[j++];
+        } else {
+            task->dst[k++] = task->src[i++];
+        }
+    }
+    memcpy(task->dst + k, task->src + i, sizeof(SortKey) * (task->mid - i));
+    k += task->mid - i;
+    memcpy(task->dst + k, task->src + j, sizeof(SortKey) * (task->end - j));
+    return NULL;
+}
+
+// Stable sort of `keys[0, size)` with `n_thread` threads.
+// Runs are sorted on their own threads, then adjacent runs are merged
+// pairwise, one thread per pair, until a single run remains.
+// Returns:
+//     sorted keys, either `keys` or `buffer`.
+SortKey* parallel_sort_keys(SortKey* keys, SortKey* buffer, int size, int n_thread) {
+    int i;
+    int bounds[MAX_THREADS + 1];
+    SortTask tasks[MAX_THREADS];
+    if (n_thread < 1) {
+        n_thread = 1;
+    }
+    if (n_thread > MAX_THREADS) {
+        n_thread = MAX_THREADS;
+    }
+
+    for (i = 0; i <= n_thread; ++i) {
+        bounds[i] = (int)((long long)size * i / n_thread);
+    }
+    for (i = 0; i < n_thread; ++i) {
+        tasks[i].src = keys;
+        tasks[i].begin = bounds[i];
+        tasks[i].end = bounds[i + 1];
+    }
+    run_tasks(sort_run_task, tasks, sizeof(SortTask), n_thread);
+
+    SortKey* src = keys;
+    SortKey* dst = buffer;
+    int n_run = n_thread;
+    while (n_run > 1) {
+        int n_task = 0;
+        for (i = 0; i < n_run; i += 2) {
+            SortTask* task = &tasks[n_task++];
+            task->src = src;
+            task->dst = dst;
+            task->begin = bounds[i];
+            task->mid = bounds[i + 1];
+            task->end = i + 2 <= n_run ? bounds[i + 2] : bounds[i + 1];
+        }
+        run_tasks(merge_run_task, tasks, sizeof(SortTask), n_task);
+
+        for (i = 0; i < n_task; ++i) {
+            bounds[i + 1] = tasks[i].end;
+        }
+        n_run = n_task;
+
+        SortKey* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    return src;
+}
+
+// Sort text records `input` by major, then by studentID, into `output`.
+// Records are parsed and sorted with `n_thread` threads,
+// only key/index pairs move while sorting.
+// Returns:
+//     1 for success.
+//     0 for failure.
+int sort_records(const char* input, const char* output, int n_thread) {
+    MappedFile file;
+    if (!map_file(&file, input)) {
+        return 0;
+    }
+
+    int i;
+    StudentView* views;
+    int n_view = parallel_parse_views(&file, &views, n_thread);
+
+    int* ranks = malloc(sizeof(int) * (n_view > 0 ? n_view : 1));
+    SortKey* keys = malloc(sizeof(SortKey) * (n_view > 0 ? n_view : 1));
+    SortKey* buffer = malloc(sizeof(SortKey) * (n_view > 0 ? n_view : 1));
+    int ok = ranks != NULL && keys != NULL && buffer != NULL
+        && rank_majors(views, n_view, ranks);
+
+    if (ok) {
+        for (i = 0; i < n_view; ++i) {
+            keys[i].key = (unsigned long long)ranks[i] << 32
+                | ((unsigned int)views[i].studentID ^ 0x80000000u);
+            keys[i].idx = i;
+        }
+        SortKey* sorted = parallel_sort_keys(keys, buffer, n_view, n_thread);
+
+        IovWriter* writer = open_iov_writer(output);
+        for (i = 0; i < n_view; ++i) {
+            write_view(writer, &views[sorted[i].idx]);
+        }
+        ok = close_iov_writer(writer);
+    }
+
+    free(ranks);
+    free(keys);
+    free(buffer);
+    free(views);
+    unmap_file(&file);
+    return ok;
+}
+
+// Record of `check_sort` with its input position, equal keys keep input order.
+typedef struct {
+    studentT student;
+    int idx;
+} CheckRecord;
+
+int compare_check_record(const void* lhs, const void* rhs) {
+    const CheckRecord* a = lhs;
+    const CheckRecord* b = rhs;
+    int res = strcmp(a->student.major, b->student.major);
+    if (res != 0) {
+        return res;
+    }
+    if (a->student.studentID != b->student.studentID) {
+        return a->student.studentID < b->student.studentID ? -1 : 1;
+    }
+    return (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+// Check `sort_records` on `n_record` generated records separated by mixed whitespace.
+// Expected output is loaded through `load_store`, sorted with qsort
+// and formatted as "%s %d %s\n", `sort_records` must write the same bytes.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Files could not be written or outputs differ.
+int check_sort(int n_record, int n_thread) {
+    static const char* separators[] = { " ", " ", "\t", "\n", "\r\n", " \t " };
+    const char* input = "check_input.txt";
+    const char* output = "check_sorted.txt";
+    int i;
+
+    FILE* fp = fopen(input, "w");
+    if (fp == NULL) {
+        return 0;
+    }
+    srand(1);
+    fprintf(fp, "%d\n", n_record);
+    for (i = 0; i < n_record; ++i) {
+        fprintf(fp, "n%d%s%d%sm%d%s", rand() % 100000, separators[rand() % 6],
+                rand() % 2001 - 1000, separators[rand() % 6],
+                rand() % 50, i % 3 ? "\n" : separators[rand() % 6]);
+    }
     fclose(fp);
 
-    for (i = 0; i < n_input; ++i) {
-        free(arr[i].name);
-        free(arr[i].major);
+    int ok = sort_records(input, output, n_thread);
+
+    fp = fopen(input, "r");
+    StudentStore store = make_store();
+    int n_load = fp != NULL ? load_store(&store, fp) : 0;
+    if (fp != NULL) {
+        fclose(fp);
+    }
+
+    CheckRecord* records = malloc(sizeof(CheckRecord) * (n_load > 0 ? n_load : 1));
+    for (i = 0; i < n_load; ++i) {
+        records[i].student = get_student(&store, i);
+        records[i].idx = i;
+    }
+    qsort(records, n_load, sizeof(CheckRecord), compare_check_record);
+
+    // Compare line by line, generated lines are short.
+    int n_mismatch = n_load != n_record;
+    char expected[256];
+    char line[256];
+    fp = ok ? fopen(output, "r") : NULL;
+    ok = fp != NULL;
+    for (i = 0; i < n_load && fp != NULL; ++i) {
+        snprintf(expected, sizeof(expected), "%s %d %s\n", records[i].student.name,
+                 records[i].student.studentID, records[i].student.major);
+        if (fgets(line, sizeof(line), fp) == NULL || strcmp(line, expected)) {
+            ++n_mismatch;
+        }
+    }
+    if (fp != NULL) {
+        n_mismatch += fgets(line, sizeof(line), fp) != NULL;
+        fclose(fp);
+    }
+    printf("%d records, %d mismatches\n", n_load, n_mismatch);
+
+    free(records);
+    delete_store(&store);
+    remove(input);
+    remove(output);
+    return ok && n_mismatch == 0;
+}
+
+// Run converter or lookup command.
+// Usage:
+//     -to-binary <text> <binary>: convert text records to binary file.
+//     -to-text <binary> <text>: convert binary file to text records.
+//     -find <binary> <id>: print record with `id` to stdout.
+//     -sort <text> <text> [<n_thread>]: sort records by major, then by studentID.
+//     -check-sort <n_record> [<n_thread>]: check -sort against formatted records
+//                                          separated by mixed whitespace.
+// Returns:
+//     exit status of the command.
+int run_command(int argc, char* argv[]) {
+    if (!strcmp(argv[1], "-to-binary") && argc == 4) {
+        return !text_to_binary(argv[2], argv[3]);
+    }
+    if (!strcmp(argv[1], "-to-text") && argc == 4) {
+        return !binary_to_text(argv[2], argv[3]);
+    }
+    if (!strcmp(argv[1], "-find") && argc == 4) {
+        BinaryStore store;
+        if (!open_binary(&store, argv[2])) {
+            fprintf(stderr, "invalid binary file %s\n", argv[2]);
+            return 1;
+        }
+
+        studentT student;
+        int id = atoi(argv[3]);
+        int found = find_binary(&store, id, &student);
+        if (found > 0) {
+            printf("%s %d %s\n", student.name, student.studentID, student.major);
+        } else if (found == 0) {
+            printf("Student ID %d is not found\n", id);
+        } else {
+            fprintf(stderr, "invalid binary file %s\n", argv[2]);
+        }
+
+        close_binary(&store);
+        return found <= 0;
+    }
+
+    if (!strcmp(argv[1], "-sort") && (argc == 4 || argc == 5)) {
+        return !sort_records(argv[2], argv[3], argc == 5 ? atoi(argv[4]) : 1);
+    }
+
+    if (!strcmp(argv[1], "-check-sort") && (argc == 3 || argc == 4)) {
+        return !check_sort(atoi(argv[2]), argc == 4 ? atoi(argv[3]) : 1);
     }
-    free(arr);
+
+    fprintf(stderr, "unknown command %s\n", argv[1]);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return run_command(argc, argv);
+    }
+
+    // Zero-copy path over mapped input.
+    MappedFile file;
+    if (map_file(&file, "input.txt")) {
+        int ok = pass_through(&file, "output.txt");
+        unmap_file(&file);
+        return !ok;
+    }
+
+    // Copying path for input that cannot be mapped.
+    FILE* fp = fopen("input.txt", "r");
+
+    int i;
+    StudentStore store = make_store();
+    load_store(&store, fp);
+
+    fclose(fp);
+
+    fp = fopen("output.txt", "w");
+    for (i = 0; i < store.size; ++i) {
+        studentT student = get_student(&store, i);
+        fprintf(fp, "%s %d %s\n", student.name, student.studentID, student.major);
+    }
+
+    fclose(fp);
+
+    delete_store(&store);
 
     return 0;
-}
\ No newline at end of file
+}
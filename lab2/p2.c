@@ -1,32 +1,348 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "../tasks.h"
+
+// Maximum level of skip list, enough for 4^16 elements.
+#define MAX_LEVEL 16
+
+// Bytes per slab of arena allocator.
+#define SLAB_SIZE (1 << 16)
+
+// Elements per block of unrolled list, 16 ids fill one cache line.
+#define BLOCK_ELEMS 16
+
+// Bytes per cache line, blocks of unrolled list start on one.
+#define CACHE_LINE 64
+
+// Bytes of output buffer, flushed in whole blocks.
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+// Maximum number of threads sharing concurrent skip list.
+#define MAX_THREADS 64
+
+// Retired nodes between attempts to advance epoch.
+#define RETIRE_INTERVAL 64
+
+// Ids owned by writers of stress test, odd ids are never deleted.
+#define STRESS_KEY_RANGE 2048
 
 typedef struct {
     int id;
     char* name;
 } Elem;
 
+// Skip list node with `level` forward pointers.
 typedef struct Node_ {
     Elem elem;
-    struct Node_* next;
+    int level;
+    struct Node_* next[1];
 } Node;
 
-Node* empty_node() {
-    Node* node = malloc(sizeof(Node));
+// Header of slab, memory follows it.
+typedef struct Slab_ {
+    struct Slab_* next;
+} Slab;
+
+// Bump allocator over linked slabs, freed all at once.
+typedef struct {
+    Slab* slabs;
+    char* cur;
+    char* end;
+} Arena;
+
+Arena empty_arena() {
+    Arena arena;
+    arena.slabs = NULL;
+    arena.cur = NULL;
+    arena.end = NULL;
+    return arena;
+}
+
+void delete_arena(Arena* arena) {
+    while (arena->slabs != NULL) {
+        Slab* next = arena->slabs->next;
+        free(arena->slabs);
+        arena->slabs = next;
+    }
+    arena->cur = NULL;
+    arena->end = NULL;
+}
+
+// Allocate `size` bytes aligned to `align` from `arena`,
+// size is rounded up to alignment so consecutive blocks stay aligned.
+// Condition:
+//     `align` is a power of two, at least pointer size.
+// Returns:
+//     NULL, if new slab could not be allocated
+//     pointer to memory, if otherwise
+void* arena_alloc_aligned(Arena* arena, size_t size, size_t align) {
+    size = (size + align - 1) & ~(align - 1);
+    char* cur = (char*)(((uintptr_t)arena->cur + align - 1) & ~(uintptr_t)(align - 1));
+    if (arena->cur == NULL || cur > arena->end || (size_t)(arena->end - cur) < size) {
+        size_t slab_size = size + align > SLAB_SIZE ? size + align : SLAB_SIZE;
+        Slab* slab = malloc(sizeof(Slab) + slab_size);
+        if (slab == NULL) {
+            return NULL;
+        }
+        slab->next = arena->slabs;
+        arena->slabs = slab;
+        arena->cur = (char*)(slab + 1);
+        arena->end = arena->cur + slab_size;
+        cur = (char*)(((uintptr_t)arena->cur + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    arena->cur = cur + size;
+    return cur;
+}
+
+// Allocate pointer-aligned `size` bytes from `arena`.
+void* arena_alloc(Arena* arena, size_t size) {
+    return arena_alloc_aligned(arena, size, sizeof(void*));
+}
+
+// Pool of skip list nodes, one free list per level.
+typedef struct {
+    Arena arena;
+    Node* free_list[MAX_LEVEL + 1];
+} NodePool;
+
+// Interned names, stored once in arena and looked up by open addressing.
+typedef struct {
+    Arena arena;
+    char** slots;
+    int capacity;
+    int size;
+} NameTable;
+
+// Skip list ordered by id, `head` is a sentinel with MAX_LEVEL pointers.
+// Pooled list takes nodes from `pool` and interns names in `names`,
+// otherwise every node and name is a separate malloc.
+typedef struct {
+    Node* head;
+    int level;
+    unsigned int seed;
+
+    int pooled;
+    NodePool pool;
+    NameTable names;
+} SkipList;
+
+size_t node_size(int level) {
+    return sizeof(Node) + sizeof(Node*) * (level - 1);
+}
+
+NodePool empty_pool() {
+    NodePool pool;
+    pool.arena = empty_arena();
+    memset(pool.free_list, 0, sizeof(pool.free_list));
+    return pool;
+}
+
+// Take node of `level` from free list, or carve it from slab.
+// Returns:
+//     NULL, if slab could not be allocated
+//     node, if otherwise
+Node* pool_alloc(NodePool* pool, int level) {
+    Node* node = pool->free_list[level];
+    if (node != NULL) {
+        pool->free_list[level] = node->next[0];
+        return node;
+    }
+    return arena_alloc(&pool->arena, node_size(level));
+}
+
+// Return node to free list of its level.
+void pool_free(NodePool* pool, Node* node) {
+    node->next[0] = pool->free_list[node->level];
+    pool->free_list[node->level] = node;
+}
+
+NameTable empty_name_table() {
+    NameTable table;
+    table.arena = empty_arena();
+    table.capacity = 64;
+    table.size = 0;
+    table.slots = calloc(table.capacity, sizeof(char*));
+    return table;
+}
+
+void delete_name_table(NameTable* table) {
+    delete_arena(&table->arena);
+    free(table->slots);
+    table->slots = NULL;
+}
+
+// FNV-1a hash of string.
+unsigned int hash_name(const char* name) {
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+// Slot of `name` in `slots`, or empty slot where it should go.
+char** find_name_slot(char** slots, int capacity, const char* name) {
+    unsigned int idx = hash_name(name) & (capacity - 1);
+    while (slots[idx] != NULL && strcmp(slots[idx], name)) {
+        idx = (idx + 1) & (capacity - 1);
+    }
+    return &slots[idx];
+}
+
+// Intern `name`, equal names share one copy in arena.
+// Returns:
+//     NULL, if table could not grow or name could not be copied
+//     interned name, if otherwise
+char* intern_name(NameTable* table, const char* name) {
+    char** slot = find_name_slot(table->slots, table->capacity, name);
+    if (*slot != NULL) {
+        return *slot;
+    }
 
-    node->next = NULL;
+    // Grow table at half load.
+    if ((table->size + 1) * 2 > table->capacity) {
+        int i;
+        int capacity = table->capacity * 2;
+        char** slots = calloc(capacity, sizeof(char*));
+        if (slots == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < table->capacity; ++i) {
+            if (table->slots[i] != NULL) {
+                *find_name_slot(slots, capacity, table->slots[i]) = table->slots[i];
+            }
+        }
+        free(table->slots);
+        table->slots = slots;
+        table->capacity = capacity;
+        slot = find_name_slot(slots, capacity, name);
+    }
+
+    char* copy = arena_alloc(&table->arena, strlen(name) + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    strcpy(copy, name);
+    *slot = copy;
+    ++table->size;
+    return copy;
+}
+
+void init_node(Node* node, int level) {
+    int i;
+    for (i = 0; i < level; ++i) {
+        node->next[i] = NULL;
+    }
+    node->level = level;
     node->elem.id = 0;
     node->elem.name = NULL;
+}
 
+Node* empty_node(int level) {
+    Node* node = malloc(node_size(level));
+    if (node != NULL) {
+        init_node(node, level);
+    }
     return node;
 }
 
+SkipList empty_list(int pooled) {
+    SkipList list;
+    list.head = empty_node(MAX_LEVEL);
+    list.level = 1;
+    list.seed = 2463534242u;
+
+    list.pooled = pooled;
+    list.pool = empty_pool();
+    list.names = empty_name_table();
+    return list;
+}
+
+// Node of `level` from pool or heap.
+// Returns:
+//     NULL, if node could not be allocated
+//     node, if otherwise
+Node* alloc_node(SkipList* list, int level) {
+    if (!list->pooled) {
+        return empty_node(level);
+    }
+    Node* node = pool_alloc(&list->pool, level);
+    if (node != NULL) {
+        init_node(node, level);
+    }
+    return node;
+}
+
+void free_node(SkipList* list, Node* node) {
+    if (!list->pooled) {
+        free(node->elem.name);
+        free(node);
+        return;
+    }
+    pool_free(&list->pool, node);
+}
+
+// Copy of `name` owned by `list`.
+// Returns:
+//     NULL, if name could not be copied
+//     copy, if otherwise
+char* store_name(SkipList* list, const char* name) {
+    if (list->pooled) {
+        return intern_name(&list->names, name);
+    }
+    char* copy = malloc(sizeof(char) * (strlen(name) + 1));
+    if (copy != NULL) {
+        strcpy(copy, name);
+    }
+    return copy;
+}
+
+void delete_list(SkipList* list) {
+    Node* node = list->head->next[0];
+    while (!list->pooled && node != NULL) {
+        Node* next = node->next[0];
+        free_node(list, node);
+        node = next;
+    }
+    free(list->head);
+    list->head = NULL;
+
+    // Pooled nodes and names go away with their slabs.
+    delete_arena(&list->pool.arena);
+    delete_name_table(&list->names);
+}
+
+// Level of new node, each level promoted with probability 1/4.
+// Xorshift keeps runs reproducible.
+int level_from_seed(unsigned int* seed) {
+    int level = 1;
+    unsigned int x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+
+    while ((x & 3) == 0 && level < MAX_LEVEL) {
+        ++level;
+        x >>= 2;
+    }
+    return level;
+}
+
+int random_level(SkipList* list) {
+    return level_from_seed(&list->seed);
+}
+
 void print_node(Node* node, FILE* output) {
     fprintf(output, "-----LIST-----\n");
     while (node != NULL) {
         fprintf(output, "%d %s\n", node->elem.id, node->elem.name);
-        node = node->next;
+        node = node->next[0];
     }
     fprintf(output, "--------------\n");
 }
@@ -40,78 +356,115 @@ void print_current_node(Node* node, FILE* output) {
             fprintf(output, "-");
         }
         fprintf(output, "%d %s", node->elem.id, node->elem.name);
-        
+
         sep = 1;
-        node = node->next;
+        node = node->next[0];
     }
 
     fprintf(output, "\n");
 }
 
-Node* find_node(Node* node, int id) {
-    while (node != NULL) {
-        if (node->elem.id == id) {
-            return node;
+// Find last node with id less than `id` on every level.
+// Returns:
+//     first node with id not less than `id`, or NULL.
+Node* insertion_point(SkipList* list, int id, Node** update) {
+    int i;
+    Node* node = list->head;
+    for (i = list->level - 1; i >= 0; --i) {
+        while (node->next[i] != NULL && node->next[i]->elem.id < id) {
+            node = node->next[i];
+        }
+        if (update != NULL) {
+            update[i] = node;
         }
-        node = node->next;
     }
-    return NULL;
+    return node->next[0];
 }
 
-int delete_node(Node* node, int id) {
-    if (node->elem.id == id) {
-        Node* new_head = node->next;
-        free(node);
-        return 1;
+Node* find_node(SkipList* list, int id) {
+    Node* node = insertion_point(list, id, NULL);
+    if (node != NULL && node->elem.id == id) {
+        return node;
     }
+    return NULL;
+}
 
-    Node* prev = node;
-    node = node->next;
-
-    while (node != NULL) {
-        if (node->elem.id == id) {
-            prev->next = node->next;
-            free(node);
-            return 1;
-        }
+int delete_node(SkipList* list, int id) {
+    Node* update[MAX_LEVEL];
+    Node* node = insertion_point(list, id, update);
+    if (node == NULL || node->elem.id != id) {
+        return 0;
+    }
 
-        prev = node;
-        node = node->next;
+    int i;
+    for (i = 0; i < node->level; ++i) {
+        update[i]->next[i] = node->next[i];
+    }
+    while (list->level > 1 && list->head->next[list->level - 1] == NULL) {
+        --list->level;
     }
 
-    return 0;
+    free_node(list, node);
+    return 1;
 }
 
-Node* insert_node(Node* node, Elem elem) {
-    Node* new_node = empty_node();
+// Link new node of `elem` after predecessors `update`.
+// Returns:
+//     NULL, if node could not be allocated, list is unchanged
+//     new node, if otherwise
+Node* insert_node(SkipList* list, Node** update, Elem elem) {
+    int i;
+    int level = random_level(list);
+    Node* new_node = alloc_node(list, level);
+    if (new_node == NULL) {
+        return NULL;
+    }
+    for (i = list->level; i < level; ++i) {
+        update[i] = list->head;
+    }
+    if (level > list->level) {
+        list->level = level;
+    }
 
     new_node->elem = elem;
-    new_node->next = node->next;
+    for (i = 0; i < level; ++i) {
+        new_node->next[i] = update[i]->next[i];
+        update[i]->next[i] = new_node;
+    }
 
-    node->next = new_node;
     return new_node;
 }
 
-Node* insertion_point(Node* node, int id) {
-    if (node == NULL || node->elem.id > id) {
-        return NULL;
-    }
+// Output of command results.
+// In delta mode, inserts and deletes report only the changed element,
+// and the whole list is printed every `snapshot_interval` changes.
+typedef struct {
+    FILE* fp;
+    int delta;
+    int snapshot_interval;
+    int n_change;
+} Output;
 
-    Node* prev = node;
-    node = node->next;
+// Report list after change of `elem`, `sign` is '+' for insertion, '-' for deletion.
+void report_change(SkipList* list, Output* output, char sign, Elem elem) {
+    if (!output->delta) {
+        print_current_node(list->head->next[0], output->fp);
+        return;
+    }
 
-    while (node != NULL) {
-        if (node->elem.id > id) {
-            break;
-        }
-        prev = node;
-        node = node->next;
+    if (sign == '+') {
+        fprintf(output->fp, "Current List + %d %s\n", elem.id, elem.name);
+    } else {
+        fprintf(output->fp, "Current List - %d\n", elem.id);
     }
 
-    return prev;
+    ++output->n_change;
+    if (output->snapshot_interval > 0 && output->n_change % output->snapshot_interval == 0) {
+        print_current_node(list->head->next[0], output->fp);
+    }
 }
 
-void insert(Node* head, FILE* input, FILE* output) {
+void insert(SkipList* list, FILE* input, Output* output) {
     int id = 0;
     char name[1024] = { 0, };
     fscanf(input, "%d %s", &id, name);
@@ -120,91 +473,1140 @@ void insert(Node* head, FILE* input, FILE* output) {
     name[size] = ' ';
 
     fscanf(input, "%s", &name[size + 1]);
-    size = strlen(name) + 1;
 
-    if (find_node(head->next, id)) {
-        fprintf(output, "Insertion Failed. ID %d already exists\n", id);
+    // Single walk for both duplicate check and insertion point.
+    Node* update[MAX_LEVEL];
+    Node* point = insertion_point(list, id, update);
+    if (point != NULL && point->elem.id == id) {
+        fprintf(output->fp, "Insertion Failed. ID %d already exists\n", id);
         return;
     }
 
     Elem elem;
     elem.id = id;
-    elem.name = malloc(sizeof(char) * size);
-
-    strcpy(elem.name, name);
-    
-    Node* point = insertion_point(head->next, id);
-    if (point == NULL) {
-        insert_node(head, elem);
-    } else {
-        insert_node(point, elem);
+    elem.name = store_name(list, name);
+    if (elem.name == NULL || insert_node(list, update, elem) == NULL) {
+        if (!list->pooled) {
+            free(elem.name);
+        }
+        fprintf(output->fp, "Insertion Failed. ID %d could not be stored\n", id);
+        return;
     }
 
-    fprintf(output, "Insertion Success : %d\n", id);
-    print_current_node(head->next, output);
+    fprintf(output->fp, "Insertion Success : %d\n", id);
+    report_change(list, output, '+', elem);
 }
 
-void find(Node* head, FILE* input, FILE* output) {
+void find(SkipList* list, FILE* input, Output* output) {
     int id = 0;
     fscanf(input, "%d", &id);
 
-    head = head->next;
-    while (head != NULL) {
-        if (head->elem.id == id) {
-            fprintf(output, "Find Success : %d %s\n", head->elem.id, head->elem.name);
-            return;
-        }
-        head = head->next;
+    Node* node = find_node(list, id);
+    if (node != NULL) {
+        fprintf(output->fp, "Find Success : %d %s\n", node->elem.id, node->elem.name);
+        return;
     }
 
-    fprintf(output, "Find %d Failed. There is no student ID\n", id);
+    fprintf(output->fp, "Find %d Failed. There is no student ID\n", id);
 }
 
-void delete(Node* head, FILE* input, FILE* output) {
+void delete(SkipList* list, FILE* input, Output* output) {
     int id = 0;
     fscanf(input, "%d", &id);
 
-    if (delete_node(head->next, id)) {
-        fprintf(output, "Deletion Success : %d\n", id);
-        print_current_node(head->next, output);
+    Elem elem;
+    elem.id = id;
+    elem.name = NULL;
+    if (delete_node(list, id)) {
+        fprintf(output->fp, "Deletion Success : %d\n", id);
+        report_change(list, output, '-', elem);
+    } else {
+        fprintf(output->fp, "Deletion Failed : Student ID %d is not in the list.\n", id);
+    }
+}
+
+// Pair of id and input position for bulk load.
+typedef struct {
+    int id;
+    int idx;
+} IdIndex;
+
+// Compare by id, then by input position.
+int compare_id_index(const void* lhs, const void* rhs) {
+    const IdIndex* a = lhs;
+    const IdIndex* b = rhs;
+    if (a->id != b->id) {
+        return a->id < b->id ? -1 : 1;
+    }
+    return (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+// Insert `elems[0, n)` at once in O(n log n).
+// Batch is sorted once and deduplicated against itself and the list,
+// then merged with existing nodes by relinking every level from left to right.
+// Rejected elements are reported in input order as sequential inserts would.
+// Returns:
+//     number of inserted elements, or -1 if batch could not be sorted.
+int bulk_load(SkipList* list, Elem* elems, int n, Output* output) {
+    int i, l;
+    IdIndex* order = malloc(sizeof(IdIndex) * (n > 0 ? n : 1));
+    char* rejected = calloc(n > 0 ? n : 1, sizeof(char));
+    if (order == NULL || rejected == NULL) {
+        free(order);
+        free(rejected);
+        return -1;
+    }
+    for (i = 0; i < n; ++i) {
+        order[i].id = elems[i].id;
+        order[i].idx = i;
+    }
+    qsort(order, n, sizeof(IdIndex), compare_id_index);
+
+    Node* tails[MAX_LEVEL];
+    for (l = 0; l < MAX_LEVEL; ++l) {
+        tails[l] = list->head;
+    }
+
+    // Merge existing nodes with sorted batch, appending to tail of every level.
+    int n_insert = 0;
+    Node* node = list->head->next[0];
+    for (i = 0; i <= n; ++i) {
+        while (node != NULL && (i == n || node->elem.id <= order[i].id)) {
+            Node* next = node->next[0];
+            for (l = 0; l < node->level; ++l) {
+                tails[l]->next[l] = node;
+                tails[l] = node;
+            }
+            if (i < n && node->elem.id == order[i].id) {
+                rejected[order[i].idx] = 1;
+            }
+            node = next;
+        }
+        if (i == n || rejected[order[i].idx]) {
+            continue;
+        }
+        // Later duplicates of the same id in batch are rejected.
+        if (i > 0 && order[i - 1].id == order[i].id) {
+            rejected[order[i].idx] = 1;
+            continue;
+        }
+
+        // Element that could not be stored is reported and skipped.
+        Node* new_node = alloc_node(list, random_level(list));
+        char* name = new_node != NULL ? store_name(list, elems[order[i].idx].name) : NULL;
+        if (name == NULL) {
+            if (new_node != NULL) {
+                free_node(list, new_node);
+            }
+            rejected[order[i].idx] = 2;
+            continue;
+        }
+        new_node->elem.id = order[i].id;
+        new_node->elem.name = name;
+        for (l = 0; l < new_node->level; ++l) {
+            tails[l]->next[l] = new_node;
+            tails[l] = new_node;
+        }
+        ++n_insert;
+    }
+
+    list->level = 1;
+    for (l = 0; l < MAX_LEVEL; ++l) {
+        tails[l]->next[l] = NULL;
+        if (tails[l] != list->head) {
+            list->level = l + 1;
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (rejected[i] == 1) {
+            fprintf(output->fp, "Insertion Failed. ID %d already exists\n", elems[i].id);
+        } else if (rejected[i] == 2) {
+            fprintf(output->fp, "Insertion Failed. ID %d could not be stored\n", elems[i].id);
+        }
+    }
+
+    free(order);
+    free(rejected);
+    return n_insert;
+}
+
+// Bulk load roster file of "<id> <first name> <last name>" lines.
+// Nothing is inserted if records could not be held in memory.
+// Returns:
+//     number of inserted elements, or -1 if file could not be opened or held.
+int load_roster(SkipList* list, const char* path, Output* output) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    int n = 0;
+    int capacity = 1024;
+    Elem* elems = malloc(sizeof(Elem) * capacity);
+    int ok = elems != NULL;
+    char first[512], last[512];
+    int id;
+    while (ok && fscanf(fp, "%d %511s %511s", &id, first, last) == 3) {
+        if (n == capacity) {
+            Elem* grown = realloc(elems, sizeof(Elem) * capacity * 2);
+            if (grown == NULL) {
+                ok = 0;
+                break;
+            }
+            elems = grown;
+            capacity *= 2;
+        }
+        elems[n].id = id;
+        elems[n].name = malloc(strlen(first) + strlen(last) + 2);
+        if (elems[n].name == NULL) {
+            ok = 0;
+            break;
+        }
+        sprintf(elems[n].name, "%s %s", first, last);
+        ++n;
+    }
+    fclose(fp);
+
+    int n_insert = ok ? bulk_load(list, elems, n, output) : -1;
+
+    int i;
+    for (i = 0; i < n; ++i) {
+        free(elems[i].name);
+    }
+    free(elems);
+    return n_insert;
+}
+
+// Block of unrolled list, ids are packed ahead of names for searching.
+// Blocks start on cache line, so ids fill the first line of block.
+typedef struct {
+    int ids[BLOCK_ELEMS];
+    int count;
+    char* names[BLOCK_ELEMS];
+} Block;
+
+// Sorted unrolled list.
+// `fences[i]` is the last id of `blocks[i]` and is searched by binary search,
+// blocks come from `arena` and are reused by `free_blocks`.
+typedef struct {
+    Block** blocks;
+    int* fences;
+    int n_block;
+    int capacity;
+
+    Block* free_blocks;
+    Arena arena;
+    NameTable names;
+} UnrolledList;
+
+UnrolledList empty_unrolled() {
+    UnrolledList list;
+    list.n_block = 0;
+    list.capacity = 16;
+    list.blocks = malloc(sizeof(Block*) * list.capacity);
+    list.fences = malloc(sizeof(int) * list.capacity);
+    list.free_blocks = NULL;
+    list.arena = empty_arena();
+    list.names = empty_name_table();
+    return list;
+}
+
+void delete_unrolled(UnrolledList* list) {
+    free(list->blocks);
+    free(list->fences);
+    delete_arena(&list->arena);
+    delete_name_table(&list->names);
+    list->n_block = 0;
+}
+
+// Allocate empty block at position `idx` of block array.
+// Free blocks are chained through their first bytes.
+// Returns:
+//     NULL, if block or block array could not be allocated, list is unchanged
+//     new block, if otherwise
+Block* insert_block(UnrolledList* list, int idx) {
+    if (list->n_block == list->capacity) {
+        Block** blocks = realloc(list->blocks, sizeof(Block*) * list->capacity * 2);
+        if (blocks == NULL) {
+            return NULL;
+        }
+        list->blocks = blocks;
+        int* fences = realloc(list->fences, sizeof(int) * list->capacity * 2);
+        if (fences == NULL) {
+            return NULL;
+        }
+        list->fences = fences;
+        list->capacity *= 2;
+    }
+
+    Block* block = list->free_blocks;
+    if (block != NULL) {
+        list->free_blocks = *(Block**)block;
     } else {
-        fprintf(output, "Deletion Failed : Student ID %d is not in the list.\n", id);
+        block = arena_alloc_aligned(&list->arena, sizeof(Block), CACHE_LINE);
+        if (block == NULL) {
+            return NULL;
+        }
     }
+    block->count = 0;
+
+    memmove(list->blocks + idx + 1, list->blocks + idx, sizeof(Block*) * (list->n_block - idx));
+    memmove(list->fences + idx + 1, list->fences + idx, sizeof(int) * (list->n_block - idx));
+    list->blocks[idx] = block;
+    ++list->n_block;
+    return block;
+}
+
+// Unlink block at position `idx` and keep it for reuse.
+void remove_block(UnrolledList* list, int idx) {
+    Block* block = list->blocks[idx];
+    *(Block**)block = list->free_blocks;
+    list->free_blocks = block;
+
+    --list->n_block;
+    memmove(list->blocks + idx, list->blocks + idx + 1, sizeof(Block*) * (list->n_block - idx));
+    memmove(list->fences + idx, list->fences + idx + 1, sizeof(int) * (list->n_block - idx));
 }
 
-int main() {
+// Position of block that should hold `id`,
+// the first one whose last id is not less than it, or the last block.
+// Returns:
+//     -1, if list is empty
+//     block index, if otherwise
+int find_block(UnrolledList* list, int id) {
+    int lo = 0;
+    int hi = list->n_block - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (list->fences[mid] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+// First index of `block` with id not less than `id`.
+int block_lower_bound(Block* block, int id) {
+    int i = 0;
+    while (i < block->count && block->ids[i] < id) {
+        ++i;
+    }
+    return i;
+}
+
+Elem* find_unrolled(UnrolledList* list, int id, Elem* res) {
+    int b = find_block(list, id);
+    if (b < 0) {
+        return NULL;
+    }
+
+    Block* block = list->blocks[b];
+    int idx = block_lower_bound(block, id);
+    if (idx == block->count || block->ids[idx] != id) {
+        return NULL;
+    }
+    res->id = id;
+    res->name = block->names[idx];
+    return res;
+}
+
+// Insert `id`, `name` keeping blocks sorted, full block is split in half.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Id already exists, or name or block could not be allocated.
+int insert_unrolled(UnrolledList* list, int id, const char* name) {
+    int b = find_block(list, id);
+    Block* block = b >= 0 ? list->blocks[b] : NULL;
+    int idx = block != NULL ? block_lower_bound(block, id) : 0;
+    if (block != NULL && idx < block->count && block->ids[idx] == id) {
+        return 0;
+    }
+
+    // Allocate before any block changes, so failure leaves list as it was.
+    char* stored = intern_name(&list->names, name);
+    if (stored == NULL) {
+        return 0;
+    }
+    if (block == NULL) {
+        b = 0;
+        block = insert_block(list, 0);
+        if (block == NULL) {
+            return 0;
+        }
+    }
+
+    if (block->count == BLOCK_ELEMS) {
+        int half = BLOCK_ELEMS / 2;
+        Block* next = insert_block(list, b + 1);
+        if (next == NULL) {
+            return 0;
+        }
+        next->count = BLOCK_ELEMS - half;
+        memcpy(next->ids, block->ids + half, sizeof(int) * next->count);
+        memcpy(next->names, block->names + half, sizeof(char*) * next->count);
+        block->count = half;
+        list->fences[b] = block->ids[half - 1];
+        list->fences[b + 1] = next->ids[next->count - 1];
+
+        if (idx > half) {
+            block = next;
+            idx -= half;
+            ++b;
+        }
+    }
+
+    memmove(block->ids + idx + 1, block->ids + idx, sizeof(int) * (block->count - idx));
+    memmove(block->names + idx + 1, block->names + idx, sizeof(char*) * (block->count - idx));
+    block->ids[idx] = id;
+    block->names[idx] = stored;
+    ++block->count;
+    list->fences[b] = block->ids[block->count - 1];
+    return 1;
+}
+
+// Delete `id`, empty block is unlinked and reused.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Id does not exist.
+int delete_unrolled_elem(UnrolledList* list, int id) {
+    int b = find_block(list, id);
+    if (b < 0) {
+        return 0;
+    }
+
+    Block* block = list->blocks[b];
+    int idx = block_lower_bound(block, id);
+    if (idx == block->count || block->ids[idx] != id) {
+        return 0;
+    }
+
+    --block->count;
+    memmove(block->ids + idx, block->ids + idx + 1, sizeof(int) * (block->count - idx));
+    memmove(block->names + idx, block->names + idx + 1, sizeof(char*) * (block->count - idx));
+    if (block->count == 0) {
+        remove_block(list, b);
+    } else {
+        list->fences[b] = block->ids[block->count - 1];
+    }
+    return 1;
+}
+
+void print_unrolled(UnrolledList* list, FILE* output) {
+    int i, b;
+    fprintf(output, "-----LIST-----\n");
+    for (b = 0; b < list->n_block; ++b) {
+        Block* block = list->blocks[b];
+        for (i = 0; i < block->count; ++i) {
+            fprintf(output, "%d %s\n", block->ids[i], block->names[i]);
+        }
+    }
+    fprintf(output, "--------------\n");
+}
+
+double elapsed(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Benchmark insert, find and print of `n` random elements
+// on malloc skip list, pooled skip list and unrolled list.
+void benchmark(int n, FILE* output) {
+    int i, layout;
+    int* ids = malloc(sizeof(int) * n);
+    char name[64];
+    FILE* sink = fopen("/dev/null", "w");
+
+    // Shuffled ids and a name pool of 1024 distinct names.
+    for (i = 0; i < n; ++i) {
+        ids[i] = i;
+    }
+    srand(1);
+    for (i = n - 1; i > 0; --i) {
+        int j = rand() % (i + 1);
+        int tmp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = tmp;
+    }
+
+    const char* layouts[] = { "malloc skip list", "pooled skip list", "unrolled list" };
+    fprintf(output, "%-18s %10s %10s %10s\n", "layout", "insert(s)", "find(s)", "print(s)");
+    for (layout = 0; layout < 3; ++layout) {
+        SkipList list;
+        UnrolledList unrolled;
+        double t_insert, t_find, t_print;
+        Node* update[MAX_LEVEL];
+        Elem elem;
+
+        clock_t start = clock();
+        if (layout < 2) {
+            list = empty_list(layout == 1);
+            for (i = 0; i < n; ++i) {
+                sprintf(name, "Name%d Last%d", ids[i] % 1024, ids[i] % 7);
+                if (insertion_point(&list, ids[i], update) == NULL
+                    || update[0]->next[0]->elem.id != ids[i]) {
+                    elem.id = ids[i];
+                    elem.name = store_name(&list, name);
+                    insert_node(&list, update, elem);
+                }
+            }
+        } else {
+            unrolled = empty_unrolled();
+            for (i = 0; i < n; ++i) {
+                sprintf(name, "Name%d Last%d", ids[i] % 1024, ids[i] % 7);
+                insert_unrolled(&unrolled, ids[i], name);
+            }
+        }
+        t_insert = elapsed(start);
+
+        start = clock();
+        for (i = 0; i < n; ++i) {
+            if (layout < 2) {
+                find_node(&list, ids[n - 1 - i]);
+            } else {
+                find_unrolled(&unrolled, ids[n - 1 - i], &elem);
+            }
+        }
+        t_find = elapsed(start);
+
+        start = clock();
+        if (layout < 2) {
+            print_node(list.head->next[0], sink);
+            delete_list(&list);
+        } else {
+            print_unrolled(&unrolled, sink);
+            delete_unrolled(&unrolled);
+        }
+        t_print = elapsed(start);
+
+        fprintf(output, "%-18s %10.3f %10.3f %10.3f\n", layouts[layout], t_insert, t_find, t_print);
+    }
+
+    fclose(sink);
+    free(ids);
+}
+
+// Node of concurrent skip list.
+// Low bit of `next[i]` marks the node as deleted at level `i`,
+// `refs` is held by the inserter and the list, last one retires the node.
+typedef struct CNode_ {
+    Elem elem;
+    int level;
+    int refs;
+    struct CNode_* retired;
+    uintptr_t next[1];
+} CNode;
+
+// Announced epoch of one thread, `state` is epoch << 1 | active.
+// Padded to its own cache line.
+typedef struct {
+    unsigned long state;
+    char pad[CACHE_LINE - sizeof(unsigned long)];
+} EpochSlot;
+
+// Lock-free skip list with epoch based reclamation.
+// Searches unlink marked nodes on their way,
+// a node retired in epoch `e` is freed once global epoch reaches `e + 2`.
+typedef struct {
+    CNode* head;
+    unsigned long epoch;
+    int n_thread;
+    EpochSlot slots[MAX_THREADS];
+} ConcurrentSet;
+
+// Per thread handle of concurrent set.
+// Retired nodes wait in `limbo[epoch % 3]` of the retiring thread.
+typedef struct {
+    ConcurrentSet* set;
+    int tid;
+    unsigned int seed;
+    unsigned long epoch;
+    int n_retired;
+    CNode* limbo[3];
+} SetHandle;
+
+CNode* link_ptr(uintptr_t link) {
+    return (CNode*)(link & ~(uintptr_t)1);
+}
+
+int is_marked(uintptr_t link) {
+    return (int)(link & 1);
+}
+
+CNode* make_cnode(int id, const char* name, int level) {
+    CNode* node = malloc(sizeof(CNode) + sizeof(uintptr_t) * (level - 1));
+    node->elem.id = id;
+    node->elem.name = malloc(sizeof(char) * (strlen(name) + 1));
+    strcpy(node->elem.name, name);
+    node->level = level;
+    node->refs = 2;
+    node->retired = NULL;
+    memset(node->next, 0, sizeof(uintptr_t) * level);
+    return node;
+}
+
+void free_cnode(CNode* node) {
+    free(node->elem.name);
+    free(node);
+}
+
+ConcurrentSet* empty_set() {
+    ConcurrentSet* set = calloc(1, sizeof(ConcurrentSet));
+    set->head = make_cnode(0, "", MAX_LEVEL);
+    return set;
+}
+
+// Free all nodes, every thread should have closed its handle.
+void delete_set(ConcurrentSet* set) {
+    CNode* node = link_ptr(set->head->next[0]);
+    while (node != NULL) {
+        CNode* next = link_ptr(node->next[0]);
+        free_cnode(node);
+        node = next;
+    }
+    free_cnode(set->head);
+    free(set);
+}
+
+// Register new thread on `set`, called before threads start.
+SetHandle open_handle(ConcurrentSet* set, unsigned int seed) {
+    SetHandle handle;
+    handle.set = set;
+    handle.tid = set->n_thread++;
+    handle.seed = seed | 1;
+    handle.epoch = 0;
+    handle.n_retired = 0;
+    handle.limbo[0] = handle.limbo[1] = handle.limbo[2] = NULL;
+    return handle;
+}
+
+void free_limbo(CNode** limbo) {
+    CNode* node = *limbo;
+    while (node != NULL) {
+        CNode* next = node->retired;
+        free_cnode(node);
+        node = next;
+    }
+    *limbo = NULL;
+}
+
+// Free retired nodes of `handle`, all threads should be done.
+void close_handle(SetHandle* handle) {
+    int i;
+    for (i = 0; i < 3; ++i) {
+        free_limbo(&handle->limbo[i]);
+    }
+}
+
+// Enter critical section, nodes read after this stay alive until `exit_epoch`.
+// Observing new epoch `e` frees the bag of epoch `e - 2`.
+void enter_epoch(SetHandle* handle) {
+    ConcurrentSet* set = handle->set;
+    unsigned long epoch = __atomic_load_n(&set->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&set->slots[handle->tid].state, epoch << 1 | 1, __ATOMIC_SEQ_CST);
+
+    if (epoch != handle->epoch) {
+        handle->epoch = epoch;
+        free_limbo(&handle->limbo[(epoch + 1) % 3]);
+    }
+}
+
+void exit_epoch(SetHandle* handle) {
+    __atomic_store_n(&handle->set->slots[handle->tid].state, 0, __ATOMIC_RELEASE);
+}
+
+// Advance global epoch if every active thread has observed current one.
+void try_advance(ConcurrentSet* set) {
+    int i;
+    unsigned long epoch = __atomic_load_n(&set->epoch, __ATOMIC_SEQ_CST);
+    for (i = 0; i < set->n_thread; ++i) {
+        unsigned long state = __atomic_load_n(&set->slots[i].state, __ATOMIC_SEQ_CST);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return;
+        }
+    }
+    __atomic_compare_exchange_n(&set->epoch, &epoch, epoch + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+// Defer free of unlinked `node` to the end of grace period.
+// Tagged with one past the local epoch, the latest global epoch it could be unlinked in.
+void retire_cnode(SetHandle* handle, CNode* node) {
+    CNode** limbo = &handle->limbo[(handle->epoch + 1) % 3];
+    node->retired = *limbo;
+    *limbo = node;
+    if (++handle->n_retired % RETIRE_INTERVAL == 0) {
+        try_advance(handle->set);
+    }
+}
+
+void release_cnode(SetHandle* handle, CNode* node) {
+    if (__atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        retire_cnode(handle, node);
+    }
+}
+
+// Fill predecessors and successors of `id` on every level.
+// Marked nodes on the way are unlinked.
+// Returns:
+//     1 if unmarked node of `id` is found.
+//     0 if not found.
+//     -1 if unlink raced with other thread and search should restart.
+int try_search_set(ConcurrentSet* set, int id, CNode** preds, CNode** succs) {
+    int level;
+    CNode* pred = set->head;
+    CNode* curr = NULL;
+    for (level = MAX_LEVEL - 1; level >= 0; --level) {
+        curr = link_ptr(__atomic_load_n(&pred->next[level], __ATOMIC_SEQ_CST));
+        while (curr != NULL) {
+            uintptr_t succ = __atomic_load_n(&curr->next[level], __ATOMIC_SEQ_CST);
+            if (is_marked(succ)) {
+                uintptr_t expected = (uintptr_t)curr;
+                if (!__atomic_compare_exchange_n(&pred->next[level], &expected, (uintptr_t)link_ptr(succ),
+                                                 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                    return -1;
+                }
+                curr = link_ptr(succ);
+                continue;
+            }
+            if (curr->elem.id >= id) {
+                break;
+            }
+            pred = curr;
+            curr = link_ptr(succ);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+    return curr != NULL && curr->elem.id == id;
+}
+
+int search_set(ConcurrentSet* set, int id, CNode** preds, CNode** succs) {
+    int found;
+    while ((found = try_search_set(set, id, preds, succs)) < 0) {
+    }
+    return found;
+}
+
+// Wait-free lookup, marked nodes are passed over without unlinking.
+// Returns:
+//     1 if `id` is in set.
+//     0 if not.
+int contains_set(SetHandle* handle, int id) {
+    int level;
+    CNode* pred = handle->set->head;
+    CNode* curr = NULL;
+
+    enter_epoch(handle);
+    for (level = MAX_LEVEL - 1; level >= 0; --level) {
+        curr = link_ptr(__atomic_load_n(&pred->next[level], __ATOMIC_ACQUIRE));
+        while (curr != NULL && curr->elem.id < id) {
+            pred = curr;
+            curr = link_ptr(__atomic_load_n(&curr->next[level], __ATOMIC_ACQUIRE));
+        }
+    }
+    int found = curr != NULL && curr->elem.id == id
+        && !is_marked(__atomic_load_n(&curr->next[0], __ATOMIC_ACQUIRE));
+    exit_epoch(handle);
+    return found;
+}
+
+// Link new node at level 0 and then on upper levels one by one.
+// Linking stops early if node is deleted meanwhile.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Id already exists.
+int insert_set(SetHandle* handle, int id, const char* name) {
+    int level;
+    CNode* preds[MAX_LEVEL];
+    CNode* succs[MAX_LEVEL];
+    ConcurrentSet* set = handle->set;
+    int top = level_from_seed(&handle->seed);
+    CNode* node = NULL;
+
+    enter_epoch(handle);
+    while (1) {
+        if (search_set(set, id, preds, succs)) {
+            if (node != NULL) {
+                free_cnode(node);
+            }
+            exit_epoch(handle);
+            return 0;
+        }
+        if (node == NULL) {
+            node = make_cnode(id, name, top);
+        }
+        for (level = 0; level < top; ++level) {
+            node->next[level] = (uintptr_t)succs[level];
+        }
+        uintptr_t expected = (uintptr_t)succs[0];
+        if (__atomic_compare_exchange_n(&preds[0]->next[0], &expected, (uintptr_t)node,
+                                        0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            break;
+        }
+    }
+
+    for (level = 1; level < top; ++level) {
+        int linked = 0;
+        while (!linked) {
+            uintptr_t next = __atomic_load_n(&node->next[level], __ATOMIC_SEQ_CST);
+            if (is_marked(next)) {
+                break;
+            }
+            if (link_ptr(next) != succs[level]
+                && !__atomic_compare_exchange_n(&node->next[level], &next, (uintptr_t)succs[level],
+                                                0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                continue;
+            }
+            uintptr_t expected = (uintptr_t)succs[level];
+            linked = __atomic_compare_exchange_n(&preds[level]->next[level], &expected, (uintptr_t)node,
+                                                 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+            if (!linked && (!search_set(set, id, preds, succs) || succs[0] != node)) {
+                break;
+            }
+        }
+        if (!linked) {
+            break;
+        }
+    }
+
+    // Deleter may have searched before upper levels were linked, unlink them here.
+    if (is_marked(__atomic_load_n(&node->next[0], __ATOMIC_SEQ_CST))) {
+        search_set(set, id, preds, succs);
+    }
+    release_cnode(handle, node);
+    exit_epoch(handle);
+    return 1;
+}
+
+// Mark node from top level down, owner of level 0 mark unlinks it.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Id does not exist.
+int delete_set_elem(SetHandle* handle, int id) {
+    int level;
+    CNode* preds[MAX_LEVEL];
+    CNode* succs[MAX_LEVEL];
+    ConcurrentSet* set = handle->set;
+
+    enter_epoch(handle);
+    if (!search_set(set, id, preds, succs)) {
+        exit_epoch(handle);
+        return 0;
+    }
+
+    CNode* victim = succs[0];
+    for (level = victim->level - 1; level > 0; --level) {
+        uintptr_t next = __atomic_load_n(&victim->next[level], __ATOMIC_SEQ_CST);
+        while (!is_marked(next)
+               && !__atomic_compare_exchange_n(&victim->next[level], &next, next | 1,
+                                               0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        }
+    }
+
+    uintptr_t next = __atomic_load_n(&victim->next[0], __ATOMIC_SEQ_CST);
+    while (1) {
+        if (is_marked(next)) {
+            exit_epoch(handle);
+            return 0;
+        }
+        if (__atomic_compare_exchange_n(&victim->next[0], &next, next | 1,
+                                        0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            break;
+        }
+    }
+
+    search_set(set, id, preds, succs);
+    release_cnode(handle, victim);
+    exit_epoch(handle);
+    return 1;
+}
+
+// Worker of stress test and scaling benchmark.
+// Writers own even ids `2k` with `k % n_writer == writer` and check every result
+// against their own model, readers check odd ids which are never deleted.
+typedef struct {
+    SetHandle handle;
+    int writer;
+    int n_writer;
+    int n_op;
+    int key_range;
+    char* model;
+    int n_error;
+} SetTask;
+
+void* writer_task(void* arg) {
+    int i;
+    SetTask* task = arg;
+    for (i = 0; i < task->n_op; ++i) {
+        unsigned int x = task->handle.seed;
+        level_from_seed(&task->handle.seed);
+        int k = (int)(x >> 1) % (task->key_range / 2 / task->n_writer);
+        int id = 2 * (k * task->n_writer + task->writer);
+
+        if (x & 1) {
+            if (insert_set(&task->handle, id, "Stress Writer") != !task->model[id]) {
+                ++task->n_error;
+            }
+            task->model[id] = 1;
+        } else {
+            if (delete_set_elem(&task->handle, id) != task->model[id]) {
+                ++task->n_error;
+            }
+            task->model[id] = 0;
+        }
+    }
+    return NULL;
+}
+
+void* reader_task(void* arg) {
+    int i;
+    SetTask* task = arg;
+    for (i = 0; i < task->n_op; ++i) {
+        unsigned int x = task->handle.seed;
+        level_from_seed(&task->handle.seed);
+        int id = (int)(x % (unsigned int)task->key_range);
+        if (contains_set(&task->handle, id) != 1 && (id & 1)) {
+            ++task->n_error;
+        }
+    }
+    return NULL;
+}
+
+void* set_task(void* arg) {
+    SetTask* task = arg;
+    return task->writer >= 0 ? writer_task(arg) : reader_task(arg);
+}
+
+// Check every level is sorted, unmarked and contained in level 0,
+// and level 0 holds exactly the odd ids and `model`.
+// Returns:
+//     number of violations.
+int verify_set(ConcurrentSet* set, const char* model, int key_range) {
+    int level, id;
+    int n_error = 0;
+    char* seen = calloc(key_range, sizeof(char));
+
+    CNode* node = link_ptr(set->head->next[0]);
+    for (; node != NULL; node = link_ptr(node->next[0])) {
+        if (is_marked(node->next[0]) || node->elem.id < 0 || node->elem.id >= key_range) {
+            ++n_error;
+            continue;
+        }
+        seen[node->elem.id] += 1;
+    }
+    for (id = 0; id < key_range; ++id) {
+        if (seen[id] != ((id & 1) || model[id])) {
+            ++n_error;
+        }
+    }
+
+    for (level = 1; level < MAX_LEVEL; ++level) {
+        int prev = -1;
+        node = link_ptr(set->head->next[level]);
+        for (; node != NULL; node = link_ptr(node->next[level])) {
+            if (is_marked(node->next[level]) || node->elem.id <= prev
+                || node->elem.id >= key_range || !seen[node->elem.id]) {
+                ++n_error;
+                break;
+            }
+            prev = node->elem.id;
+        }
+    }
+
+    free(seen);
+    return n_error;
+}
+
+// Stress `n_thread` threads, half of them writers, for `n_op` operations each.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Any result differs from writer models or final list is inconsistent.
+int stress_set(int n_thread, int n_op, FILE* output) {
+    int i;
+    if (n_thread < 2) {
+        n_thread = 2;
+    }
+    if (n_thread > MAX_THREADS) {
+        n_thread = MAX_THREADS;
+    }
+    int n_writer = n_thread / 2;
+
+    ConcurrentSet* set = empty_set();
+    char* model = calloc(STRESS_KEY_RANGE, sizeof(char));
+    SetTask* tasks = malloc(sizeof(SetTask) * n_thread);
+    for (i = 0; i < n_thread; ++i) {
+        tasks[i].handle = open_handle(set, 2654435761u * (i + 1));
+        tasks[i].writer = i < n_writer ? i : -1;
+        tasks[i].n_writer = n_writer;
+        tasks[i].n_op = n_op;
+        tasks[i].key_range = STRESS_KEY_RANGE;
+        tasks[i].model = model;
+        tasks[i].n_error = 0;
+    }
+    for (i = 1; i < STRESS_KEY_RANGE; i += 2) {
+        insert_set(&tasks[0].handle, i, "Stress Reader");
+    }
+
+    double start = wall_time();
+    run_tasks(set_task, tasks, sizeof(SetTask), n_thread);
+    double t = wall_time() - start;
+
+    int n_error = verify_set(set, model, STRESS_KEY_RANGE);
+    for (i = 0; i < n_thread; ++i) {
+        n_error += tasks[i].n_error;
+        close_handle(&tasks[i].handle);
+    }
+    fprintf(output, "stress: %d writers, %d readers, %d ops each, %.3fs, %d errors\n",
+            n_writer, n_thread - n_writer, n_op, t, n_error);
+
+    free(tasks);
+    free(model);
+    delete_set(set);
+    return n_error == 0;
+}
+
+// Throughput of 1 writer and 1, 2, 4, ... `max_reader` readers
+// on a set of `n_key / 2` ids, each reader doing `n_op` lookups.
+// Results are checked as in `stress_set`, errors are reported per round.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Any result differs from writer model or final list is inconsistent.
+int scale_set(int n_key, int n_op, int max_reader, FILE* output) {
+    int i, n_reader;
+    int n_error = 0;
+    if (n_key < 2) {
+        n_key = 2;
+    }
+    if (max_reader > MAX_THREADS - 1) {
+        max_reader = MAX_THREADS - 1;
+    }
+
+    ConcurrentSet* set = empty_set();
+    char* model = calloc(n_key, sizeof(char));
+    SetTask* tasks = malloc(sizeof(SetTask) * (max_reader + 1));
+    for (i = 0; i <= max_reader; ++i) {
+        tasks[i].handle = open_handle(set, 2654435761u * (i + 1));
+        tasks[i].writer = i == 0 ? 0 : -1;
+        tasks[i].n_writer = 1;
+        tasks[i].key_range = n_key;
+        tasks[i].model = model;
+    }
+    for (i = 1; i < n_key; i += 2) {
+        insert_set(&tasks[0].handle, i, "Scale Reader");
+    }
+
+    fprintf(output, "%8s %12s %12s %10s %8s\n", "readers", "lookup/s", "update/s", "time(s)", "errors");
+    for (n_reader = 1; n_reader <= max_reader; n_reader *= 2) {
+        for (i = 0; i <= n_reader; ++i) {
+            tasks[i].n_op = i == 0 ? n_op / 10 : n_op;
+            tasks[i].n_error = 0;
+        }
+        double start = wall_time();
+        run_tasks(set_task, tasks, sizeof(SetTask), n_reader + 1);
+        double t = wall_time() - start;
+
+        int n_round_error = 0;
+        for (i = 0; i <= n_reader; ++i) {
+            n_round_error += tasks[i].n_error;
+        }
+        n_error += n_round_error;
+        fprintf(output, "%8d %12.0f %12.0f %10.3f %8d\n",
+                n_reader, (double)n_op * n_reader / t, (double)(n_op / 10) / t, t, n_round_error);
+    }
+
+    int n_list_error = verify_set(set, model, n_key);
+    fprintf(output, "final list: %d errors\n", n_list_error);
+    n_error += n_list_error;
+
+    for (i = 0; i <= max_reader; ++i) {
+        close_handle(&tasks[i].handle);
+    }
+    free(tasks);
+    free(model);
+    delete_set(set);
+    return n_error == 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Usage:
+    //     -bench <n>: compare node layouts on `n` elements.
+    //     -delta <k>: report only changed elements, with full list every `k` changes.
+    //     -load <file>: bulk load roster file before running commands.
+    //     -stress <n_thread> <n_op>: check concurrent skip list under contention.
+    //     -scale <n_key> <n_op> [max_reader]: lookup throughput by number of readers.
+    if (argc == 3 && !strcmp(argv[1], "-bench")) {
+        benchmark(atoi(argv[2]), stdout);
+        return 0;
+    }
+    if (argc == 4 && !strcmp(argv[1], "-stress")) {
+        return stress_set(atoi(argv[2]), atoi(argv[3]), stdout) ? 0 : 1;
+    }
+    if ((argc == 4 || argc == 5) && !strcmp(argv[1], "-scale")) {
+        return scale_set(atoi(argv[2]), atoi(argv[3]), argc == 5 ? atoi(argv[4]) : 8, stdout) ? 0 : 1;
+    }
+
+    int i;
     char opt;
+    const char* roster = NULL;
     FILE* input = fopen("input.txt", "r");
-    FILE* output = fopen("output.txt", "w");
 
-    Node* head = empty_node();
+    Output output;
+    output.fp = fopen("output.txt", "w");
+    output.delta = 0;
+    output.snapshot_interval = 0;
+    output.n_change = 0;
+    setvbuf(output.fp, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-delta")) {
+            output.delta = 1;
+            output.snapshot_interval = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-load")) {
+            roster = argv[i + 1];
+        }
+    }
+
+    SkipList list = empty_list(1);
+    if (roster != NULL && load_roster(&list, roster, &output) < 0) {
+        fprintf(stderr, "cannot load roster %s\n", roster);
+    }
+
     while (fscanf(input, "%c", &opt) == 1) {
         switch (opt) {
         case 'i':
-            insert(head, input, output);
+            insert(&list, input, &output);
             break;
         case 'd':
-            delete(head, input, output);
+            delete(&list, input, &output);
             break;
         case 'f':
-            find(head, input, output);
+            find(&list, input, &output);
             break;
         case 'p':
-            print_node(head->next, output);
+            print_node(list.head->next[0], output.fp);
             break;
         default:
             break;
         }
     }
 
-    while (head != NULL) {
-        Node* node = head->next;
-        free(head);
-        head = node;
-    }
+    delete_list(&list);
 
     fclose(input);
-    fclose(output);
+    fclose(output.fp);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,33 +1,157 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-#define MAX_STACK_SIZE 100
+#include "../fast_io.h"
+#include "../tasks.h"
+
+// Capacity of first segment, each next segment doubles it.
+#define FIRST_SEGMENT_SIZE 64
+
+// Largest segment, growth becomes linear after this.
+#define MAX_SEGMENT_SIZE (1 << 20)
+
+// Alignment of segment buffers, one cache line.
+#define CACHE_LINE 64
+
+// Elements per run of batched benchmark.
+#define BENCH_RUN 256
+
+// Maximum number of threads of stress test and benchmark.
+#define MAX_THREADS 64
+
+// Slots of elimination array and spins of push waiting on its offer.
+#define ELIMINATION_SLOTS 8
+#define ELIMINATION_SPIN 128
+
+// Offer state of elimination slot taken by pop.
+#define ELIMINATION_TAKEN 0xFFFFFFFFu
+
+// Threads and operations per thread of one linearizability round.
+#define HISTORY_THREADS 3
+#define HISTORY_OPS 4
+
+// Segment of stack, segments are chained from top to bottom.
+typedef struct Segment_ {
+    struct Segment_* prev;
+    int* buffer;
+    int idx;
+    int capacity;
+} Segment;
 
 // Struct for Stack data structure implementation.
+// Buffer grows by chaining new segments of doubled size,
+// so elements are never copied on growth.
+// One emptied segment is kept in `spare` against push/pop on its boundary.
 typedef struct {
-    int idx;
-    int buffer[MAX_STACK_SIZE];
+    Segment* top;
+    Segment* spare;
 } Stack;
 
+// Generate segment of `capacity` elements on cache aligned buffer.
+// Returns:
+//     NULL, if allocation failed.
+//     new segment, if otherwise.
+Segment* empty_segment(int capacity) {
+    Segment* segment = malloc(sizeof(Segment));
+    if (segment == NULL) {
+        return NULL;
+    }
+    if (posix_memalign((void**)&segment->buffer, CACHE_LINE, sizeof(int) * capacity) != 0) {
+        free(segment);
+        return NULL;
+    }
+    segment->prev = NULL;
+    segment->idx = 0;
+    segment->capacity = capacity;
+    return segment;
+}
+
+void delete_segment(Segment* segment) {
+    if (segment != NULL) {
+        free(segment->buffer);
+        free(segment);
+    }
+}
+
 // Generate empty stack. Initialize with start index 0.
 Stack empty_stack() {
     Stack stack;
-    stack.idx = 0;
+    stack.top = empty_segment(FIRST_SEGMENT_SIZE);
+    stack.spare = NULL;
 
     return stack;
 }
 
+void delete_stack(Stack* stack) {
+    while (stack->top != NULL) {
+        Segment* prev = stack->top->prev;
+        delete_segment(stack->top);
+        stack->top = prev;
+    }
+    delete_segment(stack->spare);
+    stack->spare = NULL;
+}
+
+// Chain new segment on full top segment, reusing spare one if exists.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Allocation failed.
+int grow_stack(Stack* stack) {
+    Segment* segment = stack->spare;
+    if (segment != NULL) {
+        stack->spare = NULL;
+    } else {
+        int capacity = stack->top->capacity * 2;
+        if (capacity > MAX_SEGMENT_SIZE) {
+            capacity = MAX_SEGMENT_SIZE;
+        }
+        segment = empty_segment(capacity);
+        if (segment == NULL) {
+            return 0;
+        }
+    }
+    segment->idx = 0;
+    segment->prev = stack->top;
+    stack->top = segment;
+    return 1;
+}
+
+// Unchain empty top segment, it is kept as spare.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Top segment is the bottom one.
+int shrink_stack(Stack* stack) {
+    Segment* segment = stack->top;
+    if (segment->prev == NULL) {
+        return 0;
+    }
+    stack->top = segment->prev;
+    delete_segment(stack->spare);
+    stack->spare = segment;
+    return 1;
+}
+
 // Push `data` into `stack`.
 // Returns:
 //     1 for success.
 //     0 for failure.
 // Failure:
-//     Push to full stack.
+//     Push to full stack, no memory for new segment.
 int push(Stack* stack, int data) {
-    if (stack->idx >= MAX_STACK_SIZE) {
-        return 0;
+    Segment* top = stack->top;
+    if (top->idx >= top->capacity) {
+        if (!grow_stack(stack)) {
+            return 0;
+        }
+        top = stack->top;
     }
-    stack->buffer[stack->idx++] = data;
+    top->buffer[top->idx++] = data;
     return 1;
 }
 
@@ -38,58 +162,702 @@ int push(Stack* stack, int data) {
 // Failure:
 //     Try to pop from empty stack.
 int pop(Stack* stack, int* res) {
-    if (stack->idx < 1) {
+    Segment* top = stack->top;
+    if (top->idx < 1) {
+        if (!shrink_stack(stack)) {
+            return 0;
+        }
+        top = stack->top;
+    }
+    *res = top->buffer[--top->idx];
+    return 1;
+}
+
+// Push `n` elements of `data` in order, `data[n - 1]` ends on top.
+// Returns:
+//     number of pushed elements, less than `n` only if allocation failed.
+int push_n(Stack* stack, const int* data, int n) {
+    int pushed = 0;
+    while (pushed < n) {
+        Segment* top = stack->top;
+        if (top->idx >= top->capacity) {
+            if (!grow_stack(stack)) {
+                break;
+            }
+            top = stack->top;
+        }
+
+        int run = top->capacity - top->idx;
+        if (run > n - pushed) {
+            run = n - pushed;
+        }
+        memcpy(top->buffer + top->idx, data + pushed, sizeof(int) * run);
+        top->idx += run;
+        pushed += run;
+    }
+    return pushed;
+}
+
+// Pop up to `n` elements and store them to `res` in pushed order,
+// old top ends on last, so `push_n` of result restores the stack.
+// Returns:
+//     number of popped elements, less than `n` only if stack became empty.
+int pop_n(Stack* stack, int* res, int n) {
+    int popped = 0;
+    while (popped < n) {
+        Segment* top = stack->top;
+        if (top->idx < 1) {
+            if (!shrink_stack(stack)) {
+                break;
+            }
+            top = stack->top;
+        }
+
+        int run = top->idx;
+        if (run > n - popped) {
+            run = n - popped;
+        }
+        top->idx -= run;
+        popped += run;
+        memcpy(res + n - popped, top->buffer + top->idx, sizeof(int) * run);
+    }
+
+    // Stack became empty before `n`, shift results to the front.
+    if (popped < n) {
+        memmove(res, res + n - popped, sizeof(int) * popped);
+    }
+    return popped;
+}
+
+double elapsed(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Benchmark `n_op` push and pop operations,
+// single element in fixed pattern and runs of BENCH_RUN elements.
+void benchmark(long long n_op, FILE* output) {
+    long long i;
+    int j, res;
+    long long checksum = 0;
+    int run[BENCH_RUN];
+    Stack stack = empty_stack();
+
+    // Sawtooth of depth 2^20, grows through all segments and unwinds again.
+    long long depth = 1 << 20;
+    clock_t start = clock();
+    for (i = 0; i < n_op / 2; i += depth) {
+        long long k, n = n_op / 2 - i < depth ? n_op / 2 - i : depth;
+        for (k = 0; k < n; ++k) {
+            push(&stack, (int)k);
+        }
+        for (k = 0; k < n; ++k) {
+            if (pop(&stack, &res)) {
+                checksum += res;
+            }
+        }
+    }
+    double t_single = elapsed(start);
+
+    for (j = 0; j < BENCH_RUN; ++j) {
+        run[j] = j;
+    }
+    start = clock();
+    for (i = 0; i < n_op / 2; i += depth) {
+        long long k, n = n_op / 2 - i < depth ? n_op / 2 - i : depth;
+        for (k = 0; k < n; k += BENCH_RUN) {
+            push_n(&stack, run, n - k < BENCH_RUN ? (int)(n - k) : BENCH_RUN);
+        }
+        for (k = 0; k < n; k += BENCH_RUN) {
+            checksum += pop_n(&stack, run, n - k < BENCH_RUN ? (int)(n - k) : BENCH_RUN);
+        }
+    }
+    double t_batch = elapsed(start);
+
+    fprintf(output, "%-12s %12s %10s\n", "mode", "ops/s", "time(s)");
+    fprintf(output, "%-12s %12.0f %10.3f\n", "push/pop", n_op / t_single, t_single);
+    fprintf(output, "%-12s %12.0f %10.3f\n", "push_n/pop_n", n_op / t_batch, t_batch);
+    fprintf(output, "checksum %lld\n", checksum);
+
+    delete_stack(&stack);
+}
+
+// Node of concurrent stack, `next` is index + 1 of node below, 0 for bottom.
+typedef struct {
+    int data;
+    unsigned int next;
+} StackNode;
+
+// Slot of elimination array, `offer` is index + 1 of node offered by push,
+// ELIMINATION_TAKEN after a pop took it and 0 if empty.
+typedef struct {
+    unsigned int offer;
+    char pad[CACHE_LINE - sizeof(unsigned int)];
+} ExchangeSlot;
+
+// Treiber stack on preallocated nodes, free nodes sit in second Treiber stack.
+// Heads are tag << 32 | index + 1, tag grows on every change against ABA,
+// so nodes can be reused as soon as they are popped.
+// Contended push and pop meet in elimination array instead of retrying on head.
+typedef struct {
+    unsigned long long head;
+    char pad0[CACHE_LINE - sizeof(unsigned long long)];
+    unsigned long long free_head;
+    char pad1[CACHE_LINE - sizeof(unsigned long long)];
+    ExchangeSlot slots[ELIMINATION_SLOTS];
+    StackNode* nodes;
+    int capacity;
+    int eliminate;
+} ConcurrentStack;
+
+// Generate empty concurrent stack of `capacity` nodes.
+// Returns:
+//     NULL, if allocation failed.
+//     new stack, if otherwise.
+ConcurrentStack* empty_concurrent_stack(int capacity, int eliminate) {
+    int i;
+    ConcurrentStack* stack;
+    if (posix_memalign((void**)&stack, CACHE_LINE, sizeof(ConcurrentStack)) != 0) {
+        return NULL;
+    }
+    memset(stack, 0, sizeof(ConcurrentStack));
+    stack->nodes = malloc(sizeof(StackNode) * capacity);
+    if (stack->nodes == NULL) {
+        free(stack);
+        return NULL;
+    }
+    stack->capacity = capacity;
+    stack->eliminate = eliminate;
+
+    for (i = 0; i < capacity; ++i) {
+        stack->nodes[i].next = i;
+    }
+    stack->free_head = capacity;
+    return stack;
+}
+
+void delete_concurrent_stack(ConcurrentStack* stack) {
+    free(stack->nodes);
+    free(stack);
+}
+
+unsigned int next_random(unsigned int* seed) {
+    unsigned int x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+// Link node `idx` on `head` with one CAS.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Head changed meanwhile.
+int try_push_index(unsigned long long* head, StackNode* nodes, unsigned int idx) {
+    unsigned long long old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&nodes[idx].next, (unsigned int)old, __ATOMIC_RELAXED);
+    unsigned long long top = ((old >> 32) + 1) << 32 | (idx + 1);
+    return __atomic_compare_exchange_n(head, &old, top, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// Unlink top node of `head` with one CAS and store its index to `idx`.
+// Stale `next` of reused node is harmless, tag makes CAS fail then.
+// Returns:
+//     1 for success.
+//     0 if empty.
+//     -1 if head changed meanwhile.
+int try_pop_index(unsigned long long* head, StackNode* nodes, unsigned int* idx) {
+    unsigned long long old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+    unsigned int top = (unsigned int)old;
+    if (top == 0) {
         return 0;
     }
-    *res = stack->buffer[--stack->idx];
+    unsigned int next = __atomic_load_n(&nodes[top - 1].next, __ATOMIC_RELAXED);
+    unsigned long long new_head = ((old >> 32) + 1) << 32 | next;
+    if (!__atomic_compare_exchange_n(head, &old, new_head, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    *idx = top - 1;
     return 1;
 }
 
-int main() {
+void push_index(unsigned long long* head, StackNode* nodes, unsigned int idx) {
+    while (!try_push_index(head, nodes, idx)) {
+    }
+}
+
+int pop_index(unsigned long long* head, StackNode* nodes, unsigned int* idx) {
+    int res;
+    while ((res = try_pop_index(head, nodes, idx)) < 0) {
+    }
+    return res;
+}
+
+// Offer node `idx` on random slot and wait for pop to take it.
+// Returns:
+//     1 if pop took it.
+//     0 if no pop came, push should retry on head.
+int exchange_push(ConcurrentStack* stack, unsigned int idx, unsigned int* seed) {
+    int i;
+    ExchangeSlot* slot = &stack->slots[next_random(seed) % ELIMINATION_SLOTS];
+    unsigned int empty = 0;
+    if (!__atomic_compare_exchange_n(&slot->offer, &empty, idx + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    for (i = 0; i < ELIMINATION_SPIN; ++i) {
+        if (__atomic_load_n(&slot->offer, __ATOMIC_ACQUIRE) == ELIMINATION_TAKEN) {
+            __atomic_store_n(&slot->offer, 0, __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+
+    // Withdraw offer, failure means pop took it just now.
+    unsigned int offer = idx + 1;
+    if (__atomic_compare_exchange_n(&slot->offer, &offer, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    __atomic_store_n(&slot->offer, 0, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Take node offered by push on random slot and store its index to `idx`.
+// Returns:
+//     1 for success.
+//     0 if no offer.
+int exchange_pop(ConcurrentStack* stack, unsigned int* idx, unsigned int* seed) {
+    ExchangeSlot* slot = &stack->slots[next_random(seed) % ELIMINATION_SLOTS];
+    unsigned int offer = __atomic_load_n(&slot->offer, __ATOMIC_ACQUIRE);
+    if (offer == 0 || offer == ELIMINATION_TAKEN) {
+        return 0;
+    }
+    if (!__atomic_compare_exchange_n(&slot->offer, &offer, ELIMINATION_TAKEN, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    *idx = offer - 1;
+    return 1;
+}
+
+// Push `data` into concurrent `stack`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Push to full stack, every node is in use.
+int concurrent_push(ConcurrentStack* stack, int data, unsigned int* seed) {
+    unsigned int idx;
+    if (!pop_index(&stack->free_head, stack->nodes, &idx)) {
+        return 0;
+    }
+    stack->nodes[idx].data = data;
+
+    while (!try_push_index(&stack->head, stack->nodes, idx)) {
+        if (stack->eliminate && exchange_push(stack, idx, seed)) {
+            break;
+        }
+    }
+    return 1;
+}
+
+// Pop element from concurrent `stack` and store it to `res`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Try to pop from empty stack.
+int concurrent_pop(ConcurrentStack* stack, int* res, unsigned int* seed) {
+    unsigned int idx;
+    int found;
+    while ((found = try_pop_index(&stack->head, stack->nodes, &idx)) < 0) {
+        if (stack->eliminate && exchange_pop(stack, &idx, seed)) {
+            found = 1;
+            break;
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+    *res = stack->nodes[idx].data;
+    push_index(&stack->free_head, stack->nodes, idx);
+    return 1;
+}
+
+// Operation of recorded history, `invoke` and `response` are ticks of shared clock.
+typedef struct {
+    int is_push;
+    int data;
+    int ok;
+    long invoke;
+    long response;
+} Operation;
+
+// Worker of stress test and benchmark.
+// Pushes values tagged by `tid` and pops as drawn from `op_seed`,
+// recording history if `ops` is set.
+typedef struct {
+    ConcurrentStack* stack;
+    int tid;
+    int n_op;
+    unsigned int op_seed;
+    unsigned int seed;
+    long* clock;
+    Operation* ops;
+    int* popped;
+    int n_popped;
+} StackTask;
+
+void* stack_task(void* arg) {
+    int i;
+    StackTask* task = arg;
+    for (i = 0; i < task->n_op; ++i) {
+        int is_push = next_random(&task->op_seed) & 1;
+        int data = task->tid << 24 | i;
+        long invoke = task->ops ? __atomic_fetch_add(task->clock, 1, __ATOMIC_SEQ_CST) : 0;
+
+        int ok = is_push
+            ? concurrent_push(task->stack, data, &task->seed)
+            : concurrent_pop(task->stack, &data, &task->seed);
+        if (!is_push && ok && task->popped) {
+            task->popped[task->n_popped++] = data;
+        }
+
+        if (task->ops) {
+            Operation* op = &task->ops[i];
+            op->is_push = is_push;
+            op->data = data;
+            op->ok = ok;
+            op->invoke = invoke;
+            op->response = __atomic_fetch_add(task->clock, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+    return NULL;
+}
+
+// Search sequential order of `ops` respecting real time order
+// that sequential stack `model` of `size` elements accepts.
+// Returns:
+//     1 if history is linearizable.
+//     0 if not.
+int linearize(Operation* ops, int n, char* done, int n_done, int* model, int size, int capacity) {
+    int i;
+    if (n_done == n) {
+        return 1;
+    }
+
+    // Only operations invoked before every pending one responded can go first.
+    long first_response = -1;
+    for (i = 0; i < n; ++i) {
+        if (!done[i] && (first_response < 0 || ops[i].response < first_response)) {
+            first_response = ops[i].response;
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        Operation* op = &ops[i];
+        if (done[i] || op->invoke > first_response) {
+            continue;
+        }
+
+        // Push overwrites slot above top, restored when this order fails.
+        int next_size = size;
+        int saved = model[size];
+        if (op->is_push) {
+            if (op->ok != (size < capacity)) {
+                continue;
+            }
+            if (op->ok) {
+                model[next_size++] = op->data;
+            }
+        } else {
+            if (op->ok != (size > 0) || (op->ok && model[size - 1] != op->data)) {
+                continue;
+            }
+            next_size -= op->ok;
+        }
+
+        done[i] = 1;
+        int found = linearize(ops, n, done, n_done + 1, model, next_size, capacity);
+        done[i] = 0;
+        model[size] = saved;
+        if (found) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Check `linearize` on fixed histories on a stack of two nodes,
+// the first needs a push undone on backtrack to be accepted.
+// Returns:
+//     1 for success.
+//     0 for failure.
+int check_linearize() {
+    // is_push, data, ok, invoke, response
+    Operation legal[5] = {
+        { 1, 1, 1, 0, 1 },
+        { 0, 1, 1, 2, 20 },
+        { 1, 5, 1, 2, 20 },
+        { 0, 5, 1, 2, 20 },
+        { 1, 8, 0, 2, 20 }
+    };
+    // Pop of 2 responds before push of 2 is invoked.
+    Operation illegal[2] = {
+        { 0, 2, 1, 0, 1 },
+        { 1, 2, 1, 2, 3 }
+    };
+    char done[5] = { 0, };
+    int model[5] = { 0, };
+    int ok = linearize(legal, 5, done, 0, model, 0, 2);
+    memset(done, 0, sizeof(done));
+    return ok && !linearize(illegal, 2, done, 0, model, 0, 2);
+}
+
+// Mark pushed value `data` as seen.
+// Returns:
+//     1 if value was never pushed or already seen.
+//     0 if otherwise.
+int mark_seen(char* seen, int data, int n_thread, int n_op) {
+    int tid = data >> 24;
+    int k = data & 0xFFFFFF;
+    if (tid < 0 || tid >= n_thread || k >= n_op) {
+        return 1;
+    }
+    return seen[(size_t)tid * n_op + k]++ != 0;
+}
+
+// Stress `n_thread` threads with `n_op` random push and pop each,
+// checking no element is lost or duplicated, then check linearizability
+// of `n_round` short histories on a stack of two nodes.
+// Returns:
+//     1 for success.
+//     0 for failure.
+int stress_stack(int n_thread, int n_op, int n_round, FILE* output) {
+    int i, j, round;
+    long clock = 0;
+    int n_error = 0;
+    if (n_thread < 1) {
+        n_thread = 1;
+    }
+    if (n_thread > MAX_THREADS) {
+        n_thread = MAX_THREADS;
+    }
+    if (n_op > 0xFFFFFF) {
+        n_op = 0xFFFFFF;
+    }
+
+    // Conservation, popped and remaining elements are exactly the pushed ones.
+    ConcurrentStack* stack = empty_concurrent_stack(n_thread * n_op, 1);
+    StackTask* tasks = malloc(sizeof(StackTask) * n_thread);
+    for (i = 0; i < n_thread; ++i) {
+        tasks[i].stack = stack;
+        tasks[i].tid = i;
+        tasks[i].n_op = n_op;
+        tasks[i].op_seed = 2654435761u * (i + 1);
+        tasks[i].seed = 40503u * (i + 1);
+        tasks[i].clock = &clock;
+        tasks[i].ops = NULL;
+        tasks[i].popped = malloc(sizeof(int) * n_op);
+        tasks[i].n_popped = 0;
+    }
+
+    double start = wall_time();
+    run_tasks(stack_task, tasks, sizeof(StackTask), n_thread);
+    double t = wall_time() - start;
+
+    char* seen = calloc((size_t)n_thread * n_op, sizeof(char));
+    int data;
+    for (i = 0; i < n_thread; ++i) {
+        for (j = 0; j < tasks[i].n_popped; ++j) {
+            n_error += mark_seen(seen, tasks[i].popped[j], n_thread, n_op);
+        }
+        free(tasks[i].popped);
+    }
+    while (concurrent_pop(stack, &data, &tasks[0].seed)) {
+        n_error += mark_seen(seen, data, n_thread, n_op);
+    }
+    for (i = 0; i < n_thread; ++i) {
+        unsigned int op_seed = 2654435761u * (i + 1);
+        for (j = 0; j < n_op; ++j) {
+            if ((next_random(&op_seed) & 1) && !seen[(size_t)i * n_op + j]) {
+                ++n_error;
+            }
+        }
+    }
+    free(seen);
+    delete_concurrent_stack(stack);
+
+    fprintf(output, "stress: %d threads, %d ops each, %.3fs, %d lost or duplicated\n",
+            n_thread, n_op, t, n_error);
+
+    // Short histories, small capacity makes full and empty results frequent.
+    int n_history = n_thread < HISTORY_THREADS ? n_thread : HISTORY_THREADS;
+    Operation ops[HISTORY_THREADS * HISTORY_OPS];
+    char done[HISTORY_THREADS * HISTORY_OPS];
+    int model[HISTORY_THREADS * HISTORY_OPS];
+    int n_violation = !check_linearize();
+    for (round = 0; round < n_round; ++round) {
+        stack = empty_concurrent_stack(2, 1);
+        clock = 0;
+        for (i = 0; i < n_history; ++i) {
+            tasks[i].stack = stack;
+            tasks[i].n_op = HISTORY_OPS;
+            tasks[i].op_seed = 2654435761u * (round * HISTORY_THREADS + i + 1);
+            tasks[i].ops = ops + i * HISTORY_OPS;
+            tasks[i].popped = NULL;
+        }
+        run_tasks(stack_task, tasks, sizeof(StackTask), n_history);
+
+        memset(done, 0, sizeof(done));
+        if (!linearize(ops, n_history * HISTORY_OPS, done, 0, model, 0, 2)) {
+            ++n_violation;
+        }
+        delete_concurrent_stack(stack);
+    }
+    fprintf(output, "linearizability: %d rounds, %d violations\n", n_round, n_violation);
+
+    free(tasks);
+    return n_error == 0 && n_violation == 0;
+}
+
+// Throughput of 1, 2, 4, ... `max_thread` threads doing `n_op` push and pop each,
+// with and without elimination.
+void scale_stack(int n_op, int max_thread, FILE* output) {
+    int i, n_thread, eliminate;
+    long clock = 0;
+    if (max_thread > MAX_THREADS) {
+        max_thread = MAX_THREADS;
+    }
+
+    StackTask* tasks = malloc(sizeof(StackTask) * max_thread);
+    fprintf(output, "%8s %14s %14s\n", "threads", "treiber op/s", "eliminate op/s");
+    for (n_thread = 1; n_thread <= max_thread; n_thread *= 2) {
+        double throughput[2];
+        for (eliminate = 0; eliminate < 2; ++eliminate) {
+            ConcurrentStack* stack = empty_concurrent_stack(n_thread * n_op, eliminate);
+            for (i = 0; i < n_thread; ++i) {
+                tasks[i].stack = stack;
+                tasks[i].tid = i;
+                tasks[i].n_op = n_op;
+                tasks[i].op_seed = 2654435761u * (i + 1);
+                tasks[i].seed = 40503u * (i + 1);
+                tasks[i].clock = &clock;
+                tasks[i].ops = NULL;
+                tasks[i].popped = NULL;
+            }
+            double start = wall_time();
+            run_tasks(stack_task, tasks, sizeof(StackTask), n_thread);
+            throughput[eliminate] = (double)n_op * n_thread / (wall_time() - start);
+            delete_concurrent_stack(stack);
+        }
+        fprintf(output, "%8d %14.0f %14.0f\n", n_thread, throughput[0], throughput[1]);
+    }
+    free(tasks);
+}
+
+// Opcodes of query stream.
+enum {
+    OP_UNKNOWN,
+    OP_PUSH,
+    OP_POP
+};
+
+// Opcode of `token` dispatched on its first byte.
+int decode_op(const char* token, int length) {
+    switch (token[0]) {
+    case 'p':
+        if (length == 4 && !memcmp(token, "push", 4)) {
+            return OP_PUSH;
+        }
+        if (length == 3 && !memcmp(token, "pop", 3)) {
+            return OP_POP;
+        }
+        break;
+    default:
+        break;
+    }
+    return OP_UNKNOWN;
+}
+
+int main(int argc, char* argv[]) {
+    // Usage:
+    //     -bench [n_op]: push/pop throughput, 10^8 operations by default.
+    //     -stress <n_thread> <n_op> [n_round]: check concurrent stack.
+    //     -scale <n_op> [max_thread]: concurrent push/pop throughput on 1 to 64 threads.
+    if (argc >= 2 && !strcmp(argv[1], "-bench")) {
+        benchmark(argc >= 3 ? atoll(argv[2]) : 100000000LL, stdout);
+        return 0;
+    }
+    if ((argc == 4 || argc == 5) && !strcmp(argv[1], "-stress")) {
+        int n_round = argc == 5 ? atoi(argv[4]) : 1000;
+        return stress_stack(atoi(argv[2]), atoi(argv[3]), n_round, stdout) ? 0 : 1;
+    }
+    if ((argc == 3 || argc == 4) && !strcmp(argv[1], "-scale")) {
+        scale_stack(atoi(argv[2]), argc == 4 ? atoi(argv[3]) : MAX_THREADS, stdout);
+        return 0;
+    }
+
     // Prepare for file I/O.
-    FILE* input = fopen("input.txt", "r");
-    FILE* output = fopen("output.txt", "w");
+    FileBuffer file;
+    if (!load_file(&file, "input.txt")) {
+        return 1;
+    }
+    Tokenizer input = make_tokenizer(file.data, file.size);
 
-    int n_query;
-    fscanf(input, "%d", &n_query);
+    OutputBuffer* output = malloc(sizeof(OutputBuffer));
+    output->fp = fopen("output.txt", "w");
+    output->size = 0;
 
-    int num, res;
-    char option[10] = { 0, };
+    int n_query = 0;
+    next_int(&input, &n_query);
+
+    int num = 0, op = OP_UNKNOWN;
+    const char* token;
 
     // Generate empty stack.
     Stack stack = empty_stack();
 
     int i;
     for (i = 0; i < n_query; ++i) {
-        fscanf(input, "%s", option);
+        // As with fscanf, a missing token repeats the previous query.
+        int length = next_token(&input, &token);
+        if (length > 0) {
+            op = decode_op(token, length);
+        }
 
+        switch (op) {
         // Push proper data to stack.
-        if (!strcmp(option, "push")) {
-            fscanf(input, "%d", &num);
-            res = push(&stack, num);
+        case OP_PUSH:
+            next_int(&input, &num);
 
             // If failure (Full of stack)
-            if (res == 0) {
-                fprintf(output, "Full\n");
+            if (!push(&stack, num)) {
+                write_text(output, "Full\n", 5);
             }
-        }
+            break;
         // Pop proper data from stack.
-        else if (!strcmp(option, "pop")) {
-            res = pop(&stack, &num);
-
+        case OP_POP:
             // If failure (Empty of stack)
-            if (res == 0) {
-                fprintf(output, "Empty\n");
+            if (!pop(&stack, &num)) {
+                write_text(output, "Empty\n", 6);
             }
             // If Success
             else {
-                fprintf(output, "%d\n", num);
+                write_int(output, num, '\n');
             }
+            break;
+        default:
+            break;
         }
     }
 
-    fclose(input);
-    fclose(output);
+    delete_stack(&stack);
+
+    flush_output(output);
+    fclose(output->fp);
+    free(output);
+    unload_file(&file);
 
     return 0;
 }
@@ -1,38 +1,139 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
-#define MAX_QUEUE_SIZE 100
+#include "../fast_io.h"
+#include "../tasks.h"
+
+// Initial capacity of queue, a power of two.
+#define INITIAL_QUEUE_SIZE 128
+
+// Bytes of cache line, concurrent queue indices sit on their own lines.
+#define CACHE_LINE 64
+
+// Maximum number of benchmark threads.
+#define MAX_THREADS 64
+
+// Failed attempts before yielding to other threads.
+#define BACKOFF_SPIN 64
+
+// Capacity of benchmarked concurrent queues.
+#define BENCH_QUEUE_SIZE 1024
+
+// Failed attempts of blocking queue before parking on futex.
+#define BLOCK_SPIN 128
+
+// Largest capacity of concurrent queues, doubling stops here.
+#define MAX_QUEUE_CAPACITY (1u << 31)
+
+// Largest capacity accepted by -blocking.
+#define MAX_BLOCKING_CAPACITY (1 << 24)
+
+// Elements per dequeue_batch of blocking mode.
+#define DEQUEUE_BATCH 256
 
 // Struct for Queue data structure implementation.
+// Ring buffer of power of two capacity, `head` and `tail` run freely
+// and are wrapped by `mask`, so size is `head - tail` even across overflow.
 typedef struct {
-    int size;
-    int head, tail;
-    int buffer[MAX_QUEUE_SIZE];
+    unsigned int head, tail;
+    unsigned int mask;
+    int* buffer;
 } Queue;
 
 // Generate empty queue. Initialize with size 0.
 Queue empty_queue() {
     Queue queue;
-    queue.size = 0;
     queue.head = 0;
     queue.tail = 0;
+    queue.mask = INITIAL_QUEUE_SIZE - 1;
+    queue.buffer = malloc(sizeof(int) * INITIAL_QUEUE_SIZE);
 
     return queue;
 }
 
+void delete_queue(Queue* queue) {
+    free(queue->buffer);
+    queue->buffer = NULL;
+}
+
+unsigned int queue_size(Queue* queue) {
+    return queue->head - queue->tail;
+}
+
+// Copy `n` elements from ring position `pos` to `dst`, at most two runs.
+void copy_from_ring(Queue* queue, unsigned int pos, int* dst, unsigned int n) {
+    unsigned int idx = pos & queue->mask;
+    unsigned int first = queue->mask + 1 - idx;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(dst, queue->buffer + idx, sizeof(int) * first);
+    memcpy(dst + first, queue->buffer, sizeof(int) * (n - first));
+}
+
+// Copy `n` elements from `src` to ring position `pos`, at most two runs.
+void copy_to_ring(Queue* queue, unsigned int pos, const int* src, unsigned int n) {
+    unsigned int idx = pos & queue->mask;
+    unsigned int first = queue->mask + 1 - idx;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(queue->buffer + idx, src, sizeof(int) * first);
+    memcpy(queue->buffer, src + first, sizeof(int) * (n - first));
+}
+
+// Grow capacity to the power of two not less than `capacity`,
+// elements are re-linearized to the front of new buffer.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Capacity overflow or allocation failed.
+int reserve_queue(Queue* queue, unsigned int capacity) {
+    unsigned int new_capacity = queue->mask + 1;
+    if (capacity <= new_capacity) {
+        return 1;
+    }
+    while (new_capacity < capacity) {
+        if (new_capacity > (1u << 30) / sizeof(int)) {
+            return 0;
+        }
+        new_capacity *= 2;
+    }
+
+    int* buffer = malloc(sizeof(int) * new_capacity);
+    if (buffer == NULL) {
+        return 0;
+    }
+    unsigned int size = queue_size(queue);
+    copy_from_ring(queue, queue->tail, buffer, size);
+    free(queue->buffer);
+
+    queue->buffer = buffer;
+    queue->mask = new_capacity - 1;
+    queue->tail = 0;
+    queue->head = size;
+    return 1;
+}
+
 // Enqueue `data` into `queue`.
 // Returns:
 //     1 for success.
 //     0 for failure.
 // Failure:
-//     Try appending data to full queue.
+//     Try appending data to full queue, which could not grow.
 int enqueue(Queue* queue, int data) {
-    if (queue->size > MAX_QUEUE_SIZE) {
+    if (queue_size(queue) > queue->mask && !reserve_queue(queue, queue->mask + 2)) {
         return 0;
     }
-    queue->buffer[queue->head] = data;
-    queue->head = (queue->head + 1) % MAX_QUEUE_SIZE;
-    queue->size += 1;
+    queue->buffer[queue->head++ & queue->mask] = data;
 
     return 1;
 }
@@ -44,61 +145,800 @@ int enqueue(Queue* queue, int data) {
 // Failure:
 //     Try dequeueing data from empty queue.
 int dequeue(Queue* queue, int* res) {
-    if (queue->size < 1) {
+    if (queue->head == queue->tail) {
         return 0;
     }
-    *res = queue->buffer[queue->tail];
-    queue->tail = (queue->tail + 1) % MAX_QUEUE_SIZE;
-    queue->size -= 1;
+    *res = queue->buffer[queue->tail++ & queue->mask];
 
     return 1;
 }
 
-int main() {
+// Enqueue `n` elements of `data` in order.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Queue could not grow, nothing is appended.
+int enqueue_n(Queue* queue, const int* data, unsigned int n) {
+    unsigned int size = queue_size(queue);
+    if (size + n < size || !reserve_queue(queue, size + n)) {
+        return 0;
+    }
+    copy_to_ring(queue, queue->head, data, n);
+    queue->head += n;
+
+    return 1;
+}
+
+// Dequeue up to `n` elements to `res` in order.
+// Returns:
+//     number of dequeued elements, less than `n` only if queue became empty.
+unsigned int dequeue_n(Queue* queue, int* res, unsigned int n) {
+    unsigned int size = queue_size(queue);
+    if (n > size) {
+        n = size;
+    }
+    copy_from_ring(queue, queue->tail, res, n);
+    queue->tail += n;
+
+    return n;
+}
+
+// Wait-free ring for one producer and one consumer.
+// Each side owns its index on its own cache line and keeps a cached copy
+// of the other side's index, reloaded only when the ring looks full or empty.
+typedef struct {
+    unsigned int head;
+    unsigned int cached_tail;
+    char pad0[CACHE_LINE - 2 * sizeof(unsigned int)];
+    unsigned int tail;
+    unsigned int cached_head;
+    char pad1[CACHE_LINE - 2 * sizeof(unsigned int)];
+    unsigned int mask;
+    int* buffer;
+} SpscQueue;
+
+// Cell of MPMC queue, `sequence` tells which lap may use it next.
+typedef struct {
+    unsigned int sequence;
+    int data;
+} Cell;
+
+// Bounded queue for many producers and consumers with per-cell sequence numbers.
+// Cell `i` accepts enqueue of position `p` when its sequence is `p`,
+// and dequeue of position `p` when it is `p + 1`.
+typedef struct {
+    unsigned int enqueue_pos;
+    char pad0[CACHE_LINE - sizeof(unsigned int)];
+    unsigned int dequeue_pos;
+    char pad1[CACHE_LINE - sizeof(unsigned int)];
+    unsigned int mask;
+    Cell* cells;
+} MpmcQueue;
+
+// Round `capacity` up to a power of two, at least 2 and at most MAX_QUEUE_CAPACITY.
+unsigned int ceil_pow2(unsigned int capacity) {
+    unsigned int res = 2;
+    while (res < capacity && res < MAX_QUEUE_CAPACITY) {
+        res *= 2;
+    }
+    return res;
+}
+
+// Generate empty SPSC queue of at least `capacity` elements.
+// Returns:
+//     NULL, if allocation failed.
+//     new queue, if otherwise.
+SpscQueue* empty_spsc_queue(unsigned int capacity) {
+    SpscQueue* queue;
+    if (posix_memalign((void**)&queue, CACHE_LINE, sizeof(SpscQueue)) != 0) {
+        return NULL;
+    }
+    memset(queue, 0, sizeof(SpscQueue));
+    capacity = ceil_pow2(capacity);
+    queue->mask = capacity - 1;
+    if (posix_memalign((void**)&queue->buffer, CACHE_LINE, sizeof(int) * capacity) != 0) {
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+void delete_spsc_queue(SpscQueue* queue) {
+    free(queue->buffer);
+    free(queue);
+}
+
+// Enqueue `data`, called only by the producer.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Try appending data to full queue.
+int enqueue_spsc(SpscQueue* queue, int data) {
+    unsigned int head = queue->head;
+    if (head - queue->cached_tail > queue->mask) {
+        queue->cached_tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        if (head - queue->cached_tail > queue->mask) {
+            return 0;
+        }
+    }
+    queue->buffer[head & queue->mask] = data;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Dequeue element to `res`, called only by the consumer.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Try dequeueing data from empty queue.
+int dequeue_spsc(SpscQueue* queue, int* res) {
+    unsigned int tail = queue->tail;
+    if (tail == queue->cached_head) {
+        queue->cached_head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if (tail == queue->cached_head) {
+            return 0;
+        }
+    }
+    *res = queue->buffer[tail & queue->mask];
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Generate empty MPMC queue of at least `capacity` elements.
+// Returns:
+//     NULL, if allocation failed.
+//     new queue, if otherwise.
+MpmcQueue* empty_mpmc_queue(unsigned int capacity) {
+    unsigned int i;
+    MpmcQueue* queue;
+    if (posix_memalign((void**)&queue, CACHE_LINE, sizeof(MpmcQueue)) != 0) {
+        return NULL;
+    }
+    memset(queue, 0, sizeof(MpmcQueue));
+    capacity = ceil_pow2(capacity);
+    queue->mask = capacity - 1;
+    if (posix_memalign((void**)&queue->cells, CACHE_LINE, sizeof(Cell) * capacity) != 0) {
+        free(queue);
+        return NULL;
+    }
+    for (i = 0; i < capacity; ++i) {
+        queue->cells[i].sequence = i;
+    }
+    return queue;
+}
+
+void delete_mpmc_queue(MpmcQueue* queue) {
+    free(queue->cells);
+    free(queue);
+}
+
+// Enqueue `data` from any thread.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Try appending data to full queue.
+int enqueue_mpmc(MpmcQueue* queue, int data) {
+    Cell* cell;
+    unsigned int pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+    while (1) {
+        cell = &queue->cells[pos & queue->mask];
+        int diff = (int)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    cell->data = data;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Dequeue element to `res` from any thread.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Try dequeueing data from empty queue.
+int dequeue_mpmc(MpmcQueue* queue, int* res) {
+    Cell* cell;
+    unsigned int pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+    while (1) {
+        cell = &queue->cells[pos & queue->mask];
+        int diff = (int)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->dequeue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    *res = cell->data;
+    __atomic_store_n(&cell->sequence, pos + queue->mask + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Queue of benchmark behind the shared enqueue/dequeue contract.
+typedef struct {
+    const char* name;
+    void* queue;
+    int (*enqueue)(void*, int);
+    int (*dequeue)(void*, int*);
+} QueueOps;
+
+int enqueue_spsc_op(void* queue, int data) {
+    return enqueue_spsc(queue, data);
+}
+
+int dequeue_spsc_op(void* queue, int* res) {
+    return dequeue_spsc(queue, res);
+}
+
+int enqueue_mpmc_op(void* queue, int data) {
+    return enqueue_mpmc(queue, data);
+}
+
+int dequeue_mpmc_op(void* queue, int* res) {
+    return dequeue_mpmc(queue, res);
+}
+
+// Back off failed attempt, yielding after a while so that
+// waiting threads make progress on fewer cores than threads.
+void backoff(int* n_fail) {
+    if (++*n_fail >= BACKOFF_SPIN) {
+        *n_fail = 0;
+        sched_yield();
+    }
+}
+
+// Worker of benchmark.
+// Producers enqueue `n_op` values, consumers dequeue until `consumed` reaches `total`.
+// Both give up once `stop` is set, as when some peers could not be started.
+// Echo tasks bounce `n_op` values back from `ops` to `reply`.
+typedef struct {
+    QueueOps* ops;
+    QueueOps* reply;
+    int producer;
+    int n_op;
+    long long total;
+    long long* consumed;
+    int* stop;
+    long long checksum;
+} QueueTask;
+
+void* queue_task(void* arg) {
+    int i, value;
+    int n_fail = 0;
+    QueueTask* task = arg;
+    QueueOps* ops = task->ops;
+
+    if (task->producer) {
+        for (i = 1; i <= task->n_op; ++i) {
+            while (!ops->enqueue(ops->queue, i)) {
+                if (__atomic_load_n(task->stop, __ATOMIC_RELAXED)) {
+                    return NULL;
+                }
+                backoff(&n_fail);
+            }
+            task->checksum += i;
+        }
+        return NULL;
+    }
+    while (__atomic_load_n(task->consumed, __ATOMIC_RELAXED) < task->total
+           && !__atomic_load_n(task->stop, __ATOMIC_RELAXED)) {
+        if (ops->dequeue(ops->queue, &value)) {
+            task->checksum += value;
+            __atomic_add_fetch(task->consumed, 1, __ATOMIC_RELAXED);
+        } else {
+            backoff(&n_fail);
+        }
+    }
+    return NULL;
+}
+
+void* echo_task(void* arg) {
+    int i, value;
+    int n_fail = 0;
+    QueueTask* task = arg;
+    for (i = 0; i < task->n_op; ++i) {
+        while (!task->ops->dequeue(task->ops->queue, &value)) {
+            backoff(&n_fail);
+        }
+        while (!task->reply->enqueue(task->reply->queue, value)) {
+            backoff(&n_fail);
+        }
+    }
+    return NULL;
+}
+
+// Throughput of `n_producer` producers and `n_consumer` consumers
+// moving `n_op` values each producer.
+// Returns:
+//     elements per second, negative if threads are unavailable or values got lost.
+double queue_throughput(QueueOps* ops, int n_producer, int n_consumer, int n_op) {
+    int i, value;
+    int n_task = n_producer + n_consumer;
+    long long consumed = 0;
+    long long produced = 0, received = 0;
+    int stop = 0;
+    QueueTask tasks[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+
+    for (i = 0; i < n_task; ++i) {
+        tasks[i].ops = ops;
+        tasks[i].reply = NULL;
+        tasks[i].producer = i < n_producer;
+        tasks[i].n_op = n_op;
+        tasks[i].total = (long long)n_op * n_producer;
+        tasks[i].consumed = &consumed;
+        tasks[i].stop = &stop;
+        tasks[i].checksum = 0;
+    }
+
+    double start = wall_time();
+    int n_spawned = spawn_tasks(queue_task, tasks, sizeof(QueueTask), n_task, threads);
+    if (n_spawned < n_task) {
+        // Started tasks would wait for missing peers forever,
+        // stop them and drop what they left so the queue can be reused.
+        __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+        join_tasks(threads, n_spawned);
+        while (ops->dequeue(ops->queue, &value)) {
+        }
+        return -1;
+    }
+    join_tasks(threads, n_task);
+    double t = wall_time() - start;
+
+    for (i = 0; i < n_task; ++i) {
+        if (tasks[i].producer) {
+            produced += tasks[i].checksum;
+        } else {
+            received += tasks[i].checksum;
+        }
+    }
+    return produced == received ? (double)n_op * n_producer / t : -1;
+}
+
+// Mean one-way latency in nanoseconds of `n_round` ping-pongs over `ops` and `reply`.
+// Returns:
+//     latency, negative if threads are unavailable.
+double queue_latency(QueueOps* ops, QueueOps* reply, int n_round) {
+    int i, value;
+    int n_fail = 0;
+    QueueTask task;
+    pthread_t thread;
+
+    task.ops = ops;
+    task.reply = reply;
+    task.n_op = n_round;
+    if (pthread_create == NULL || pthread_create(&thread, NULL, echo_task, &task) != 0) {
+        return -1;
+    }
+
+    double start = wall_time();
+    for (i = 0; i < n_round; ++i) {
+        while (!ops->enqueue(ops->queue, i)) {
+            backoff(&n_fail);
+        }
+        while (!reply->dequeue(reply->queue, &value)) {
+            backoff(&n_fail);
+        }
+    }
+    double t = wall_time() - start;
+    pthread_join(thread, NULL);
+    return t / n_round / 2 * 1e9;
+}
+
+// Benchmark SPSC and MPMC queues, `n_op` elements per producer
+// and `n_op / 100` ping-pongs for latency.
+void benchmark(int n_op, int n_producer, int n_consumer, FILE* output) {
+    if (n_producer < 1) {
+        n_producer = 1;
+    }
+    if (n_consumer < 1) {
+        n_consumer = 1;
+    }
+    if (n_producer + n_consumer > MAX_THREADS) {
+        n_producer = n_consumer = MAX_THREADS / 2;
+    }
+    if (pthread_create == NULL) {
+        fprintf(output, "threads unavailable, link with -lpthread\n");
+        return;
+    }
+
+    SpscQueue* spsc[2] = { empty_spsc_queue(BENCH_QUEUE_SIZE), empty_spsc_queue(BENCH_QUEUE_SIZE) };
+    MpmcQueue* mpmc[2] = { empty_mpmc_queue(BENCH_QUEUE_SIZE), empty_mpmc_queue(BENCH_QUEUE_SIZE) };
+    QueueOps spsc_ops[2], mpmc_ops[2];
+    int i;
+    for (i = 0; i < 2; ++i) {
+        spsc_ops[i].name = "spsc";
+        spsc_ops[i].queue = spsc[i];
+        spsc_ops[i].enqueue = enqueue_spsc_op;
+        spsc_ops[i].dequeue = dequeue_spsc_op;
+        mpmc_ops[i].name = "mpmc";
+        mpmc_ops[i].queue = mpmc[i];
+        mpmc_ops[i].enqueue = enqueue_mpmc_op;
+        mpmc_ops[i].dequeue = dequeue_mpmc_op;
+    }
+
+    fprintf(output, "%-6s %9s %9s %14s %14s\n", "queue", "producer", "consumer", "elements/s", "latency(ns)");
+    fprintf(output, "%-6s %9d %9d %14.0f %14.1f\n", "spsc", 1, 1,
+            queue_throughput(&spsc_ops[0], 1, 1, n_op),
+            queue_latency(&spsc_ops[0], &spsc_ops[1], n_op / 100 + 1));
+    fprintf(output, "%-6s %9d %9d %14.0f %14.1f\n", "mpmc", 1, 1,
+            queue_throughput(&mpmc_ops[0], 1, 1, n_op),
+            queue_latency(&mpmc_ops[0], &mpmc_ops[1], n_op / 100 + 1));
+    fprintf(output, "%-6s %9d %9d %14.0f %14s\n", "mpmc", n_producer, n_consumer,
+            queue_throughput(&mpmc_ops[0], n_producer, n_consumer, n_op), "-");
+
+    for (i = 0; i < 2; ++i) {
+        delete_spsc_queue(spsc[i]);
+        delete_mpmc_queue(mpmc[i]);
+    }
+}
+
+// Opcodes of query stream.
+enum {
+    OP_UNKNOWN,
+    OP_ENQUEUE,
+    OP_DEQUEUE
+};
+
+// Opcode of `token` dispatched on its first byte.
+int decode_op(const char* token, int length) {
+    switch (token[0]) {
+    case 'e':
+        if (length == 3 && !memcmp(token, "enQ", 3)) {
+            return OP_ENQUEUE;
+        }
+        break;
+    case 'd':
+        if (length == 3 && !memcmp(token, "deQ", 3)) {
+            return OP_DEQUEUE;
+        }
+        break;
+    default:
+        break;
+    }
+    return OP_UNKNOWN;
+}
+
+// Bounded MPMC queue which blocks on full and empty.
+// Waiters spin BLOCK_SPIN times and then park on futex of event counter,
+// other side bumps the counter only if someone is waiting on it.
+typedef struct {
+    MpmcQueue* queue;
+    unsigned int not_empty;
+    unsigned int not_full;
+    int n_waiting_consumer;
+    int n_waiting_producer;
+    int closed;
+} BlockingQueue;
+
+// Generate empty blocking queue of at least `capacity` elements.
+// Returns:
+//     NULL, if allocation failed.
+//     new queue, if otherwise.
+BlockingQueue* empty_blocking_queue(unsigned int capacity) {
+    BlockingQueue* queue = calloc(1, sizeof(BlockingQueue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->queue = empty_mpmc_queue(capacity);
+    if (queue->queue == NULL) {
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+void delete_blocking_queue(BlockingQueue* queue) {
+    delete_mpmc_queue(queue->queue);
+    free(queue);
+}
+
+// Park while `*event` equals `seen`, until `deadline` of wall_time if positive.
+// Returns:
+//     1 if woken or spuriously returned.
+//     0 if deadline passed.
+int wait_event(unsigned int* event, unsigned int seen, double deadline) {
+    struct timespec timeout;
+    struct timespec* ptimeout = NULL;
+    if (deadline > 0) {
+        double remain = deadline - wall_time();
+        if (remain <= 0) {
+            return 0;
+        }
+        timeout.tv_sec = (time_t)remain;
+        timeout.tv_nsec = (long)((remain - timeout.tv_sec) * 1e9);
+        ptimeout = &timeout;
+    }
+    syscall(SYS_futex, event, FUTEX_WAIT_PRIVATE, seen, ptimeout, NULL, 0);
+    return 1;
+}
+
+// Wake up to `n_wake` threads parked on `event` if any is waiting.
+void notify_event(unsigned int* event, int* n_waiting, int n_wake) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(n_waiting, __ATOMIC_RELAXED) > 0) {
+        __atomic_add_fetch(event, 1, __ATOMIC_SEQ_CST);
+        syscall(SYS_futex, event, FUTEX_WAKE_PRIVATE, n_wake, NULL, NULL, 0);
+    }
+}
+
+double deadline_of(int timeout_ms) {
+    return timeout_ms < 0 ? 0 : wall_time() + timeout_ms * 1e-3;
+}
+
+// Enqueue `data`, waiting up to `timeout_ms` milliseconds for space, forever if negative.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Queue is closed or timed out.
+int enqueue_blocking(BlockingQueue* queue, int data, int timeout_ms) {
+    int spin;
+    double deadline = deadline_of(timeout_ms);
+    for (spin = 0;; ++spin) {
+        if (__atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+        if (enqueue_mpmc(queue->queue, data)) {
+            notify_event(&queue->not_empty, &queue->n_waiting_consumer, 1);
+            return 1;
+        }
+        if (spin < BLOCK_SPIN) {
+            continue;
+        }
+
+        // Register before the last try, so that a dequeue after it sees the waiter.
+        unsigned int seen = __atomic_load_n(&queue->not_full, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&queue->n_waiting_producer, 1, __ATOMIC_SEQ_CST);
+        int ok = enqueue_mpmc(queue->queue, data);
+        int alive = ok || __atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE)
+            || wait_event(&queue->not_full, seen, deadline);
+        __atomic_sub_fetch(&queue->n_waiting_producer, 1, __ATOMIC_SEQ_CST);
+
+        if (ok) {
+            notify_event(&queue->not_empty, &queue->n_waiting_consumer, 1);
+            return 1;
+        }
+        if (!alive) {
+            return 0;
+        }
+    }
+}
+
+// Dequeue at least one and up to `max_n` elements to `res`,
+// waiting up to `timeout_ms` milliseconds for the first one, forever if negative.
+// Producers are woken once for the whole batch.
+// Returns:
+//     number of dequeued elements, 0 if closed and drained or timed out.
+int dequeue_batch(BlockingQueue* queue, int* res, int max_n, int timeout_ms) {
+    int spin;
+    int n = 0;
+    double deadline = deadline_of(timeout_ms);
+    for (spin = 0;; ++spin) {
+        int closed = __atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE);
+        while (n < max_n && dequeue_mpmc(queue->queue, res + n)) {
+            ++n;
+        }
+        if (n > 0) {
+            notify_event(&queue->not_full, &queue->n_waiting_producer, n);
+            return n;
+        }
+        if (closed) {
+            return 0;
+        }
+        if (spin < BLOCK_SPIN) {
+            continue;
+        }
+
+        unsigned int seen = __atomic_load_n(&queue->not_empty, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&queue->n_waiting_consumer, 1, __ATOMIC_SEQ_CST);
+        int ok = dequeue_mpmc(queue->queue, res);
+        int alive = ok || __atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE)
+            || wait_event(&queue->not_empty, seen, deadline);
+        __atomic_sub_fetch(&queue->n_waiting_consumer, 1, __ATOMIC_SEQ_CST);
+
+        if (ok) {
+            n = 1;
+        } else if (!alive) {
+            return 0;
+        }
+    }
+}
+
+// Dequeue one element to `res`, waiting as `dequeue_batch`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Queue is closed and drained or timed out.
+int dequeue_blocking(BlockingQueue* queue, int* res, int timeout_ms) {
+    return dequeue_batch(queue, res, 1, timeout_ms);
+}
+
+// Close queue, blocked producers fail and consumers drain what is left.
+void close_blocking_queue(BlockingQueue* queue) {
+    __atomic_store_n(&queue->closed, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&queue->not_empty, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&queue->not_full, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &queue->not_empty, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    syscall(SYS_futex, &queue->not_full, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// Producer of blocking pipeline, enqueues `values` in order and closes queue.
+typedef struct {
+    BlockingQueue* queue;
+    int* values;
+    unsigned int n_value;
+} ProducerTask;
+
+void* producer_task(void* arg) {
+    unsigned int i;
+    ProducerTask* task = arg;
+    for (i = 0; i < task->n_value; ++i) {
+        if (!enqueue_blocking(task->queue, task->values[i], -1)) {
+            break;
+        }
+    }
+    close_blocking_queue(task->queue);
+    return NULL;
+}
+
+// Run enqueue queries of `staged` on producer thread and `n_dequeue` dequeue queries
+// here through blocking queue of `capacity`, writing dequeued values in batches.
+// Without threads, producer runs first on a queue large enough for every value.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Blocking queue could not be allocated.
+int run_blocking(Queue* staged, unsigned int n_dequeue, unsigned int capacity, OutputBuffer* output) {
+    unsigned int i;
+    int batch[DEQUEUE_BATCH];
+    pthread_t thread;
+    ProducerTask task;
+
+    task.n_value = queue_size(staged);
+    task.values = malloc(sizeof(int) * (task.n_value + 1));
+    dequeue_n(staged, task.values, task.n_value);
+
+    task.queue = empty_blocking_queue(capacity);
+    int threaded = task.queue != NULL && pthread_create != NULL
+        && pthread_create(&thread, NULL, producer_task, &task) == 0;
+    if (!threaded) {
+        if (task.queue != NULL) {
+            delete_blocking_queue(task.queue);
+        }
+        task.queue = empty_blocking_queue(task.n_value > capacity ? task.n_value : capacity);
+        if (task.queue == NULL) {
+            free(task.values);
+            return 0;
+        }
+        producer_task(&task);
+    }
+
+    while (n_dequeue > 0) {
+        int n = dequeue_batch(task.queue, batch, n_dequeue < DEQUEUE_BATCH ? n_dequeue : DEQUEUE_BATCH, -1);
+        if (n == 0) {
+            break;
+        }
+        for (i = 0; i < (unsigned int)n; ++i) {
+            write_int(output, batch[i], '\n');
+        }
+        n_dequeue -= n;
+    }
+
+    // Producer may still wait for space nobody will free.
+    close_blocking_queue(task.queue);
+    if (threaded) {
+        pthread_join(thread, NULL);
+    }
+    delete_blocking_queue(task.queue);
+    free(task.values);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    // Usage:
+    //     -bench <n_op> [n_producer n_consumer]: SPSC and MPMC queue throughput and latency.
+    //     -blocking <capacity>: enQ runs on producer thread and deQ here on blocking queue,
+    //                           full and empty wait instead of printing "Full" and "Empty".
+    if ((argc == 3 || argc == 5) && !strcmp(argv[1], "-bench")) {
+        benchmark(atoi(argv[2]), argc == 5 ? atoi(argv[3]) : 2, argc == 5 ? atoi(argv[4]) : 2, stdout);
+        return 0;
+    }
+    int blocking = argc == 3 && !strcmp(argv[1], "-blocking");
+    int capacity = blocking ? atoi(argv[2]) : 0;
+    if (blocking && (capacity <= 0 || capacity > MAX_BLOCKING_CAPACITY)) {
+        fprintf(stderr, "capacity must be in 1 to %d\n", MAX_BLOCKING_CAPACITY);
+        return 1;
+    }
+    unsigned int n_dequeue = 0;
+
     // Prepare for file I/O.
-    FILE* input = fopen("input.txt", "r");
-    FILE* output = fopen("output.txt", "w");
+    FileBuffer file;
+    if (!load_file(&file, "input.txt")) {
+        return 1;
+    }
+    Tokenizer input = make_tokenizer(file.data, file.size);
+
+    OutputBuffer* output = malloc(sizeof(OutputBuffer));
+    output->fp = fopen("output.txt", "w");
+    output->size = 0;
 
-    int n_query;
-    fscanf(input, "%d", &n_query);
+    int n_query = 0;
+    next_int(&input, &n_query);
 
-    int num, res;
-    char option[10] = { 0, };
+    int num = 0, op = OP_UNKNOWN;
+    const char* token;
 
     // Generate empty queue.
     Queue queue = empty_queue();
 
     int i;
     for (i = 0; i < n_query; ++i) {
-        fscanf(input, "%s", option);
+        // As with fscanf, a missing token repeats the previous query.
+        int length = next_token(&input, &token);
+        if (length > 0) {
+            op = decode_op(token, length);
+        }
 
+        switch (op) {
         // Enqueue proper data to queue.
-        if (!strcmp(option, "enQ")) {
-            fscanf(input, "%d", &num);
-            res = enqueue(&queue, num);
+        case OP_ENQUEUE:
+            next_int(&input, &num);
 
             // If failure (Full of queue)
-            if (res == 0) {
-                fprintf(output, "Full\n");
+            if (!enqueue(&queue, num) && !blocking) {
+                write_text(output, "Full\n", 5);
             }
-        }
+            break;
         // Dequeue proper data from queue.
-        else if (!strcmp(option, "deQ")) {
-            res = dequeue(&queue, &num);
-
+        case OP_DEQUEUE:
+            // Blocking mode stages enQ values and counts deQ for the pipeline.
+            if (blocking) {
+                ++n_dequeue;
+            }
             // If failure (Empty of queue)
-            if (res == 0) {
-                fprintf(output, "Empty\n");
+            else if (!dequeue(&queue, &num)) {
+                write_text(output, "Empty\n", 6);
             }
             // If success
             else {
-                fprintf(output, "%d\n", num);
+                write_int(output, num, '\n');
             }
+            break;
+        default:
+            break;
         }
     }
 
-    fclose(input);
-    fclose(output);
+    int ok = 1;
+    if (blocking) {
+        ok = run_blocking(&queue, n_dequeue, (unsigned int)capacity, output);
+    }
+    delete_queue(&queue);
+
+    flush_output(output);
+    fclose(output->fp);
+    free(output);
+    unload_file(&file);
 
-    return 0;
+    return ok ? 0 : 1;
 }
@@ -1,30 +1,80 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
 
-#define MAX_BUFFER_SIZE 100
+#include "../fast_io.h"
+#include "../tasks.h"
+
+// Initial capacity of stacks and token buffers, they grow by doubling.
+#define INITIAL_BUFFER_SIZE 16
+
+// Variables are single letters, case insensitive.
+#define N_VARIABLE 26
+
+// Rows per batch of compiled program, registers of a batch stay in cache.
+#define BATCH_ROWS 1024
+
+// Column kernels are built with GCC vector extensions on x86.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLUMN_KERNEL_SIMD
+#endif
+
+// Number of int lanes in a column kernel vector.
+#define VECTOR_LANES 8
+
+// Maximum number of worker threads.
+#define MAX_THREADS 64
+
+// Subtrees smaller than this are evaluated sequentially.
+#define TREE_CUTOFF 4096
+
+// Work deques of threads are padded apart by cache line.
+#define CACHE_LINE 64
+
+// Tree contraction gives up once a round rakes less than 1/CONTRACT_STALL of leaves.
+#define CONTRACT_STALL 8
 
 // Struct for Stack data structure implementation.
+// Buffer doubles when full, so depth is bounded only by memory.
 typedef struct {
     int idx;
-    int buffer[MAX_BUFFER_SIZE];
+    int capacity;
+    int* buffer;
 } Stack;
 
 // Generate empty stack. Initialize with start index 0.
 Stack empty_stack() {
     Stack stack;
     stack.idx = 0;
+    stack.capacity = INITIAL_BUFFER_SIZE;
+    stack.buffer = malloc(sizeof(int) * stack.capacity);
 
     return stack;
 }
 
+void delete_stack(Stack* stack) {
+    free(stack->buffer);
+    stack->buffer = NULL;
+    stack->idx = 0;
+}
+
 // Push `data` into `stack`.
 // Returns:
 //     1 for success.
 //     0 for failure.
 // Failure:
-//     Try pushing data to full stack.
+//     Try pushing data to full stack, which could not grow.
 int push(Stack* stack, int data) {
-    if (stack->idx >= MAX_BUFFER_SIZE) {
-        return 0;
+    if (stack->idx >= stack->capacity) {
+        int* buffer = realloc(stack->buffer, sizeof(int) * stack->capacity * 2);
+        if (buffer == NULL) {
+            return 0;
+        }
+        stack->buffer = buffer;
+        stack->capacity *= 2;
     }
     stack->buffer[stack->idx++] = data;
     return 1;
@@ -40,7 +90,7 @@ int pop(Stack* stack, int* res) {
     if (stack->idx < 1) {
         return 0;
     }
-    
+
     --stack->idx;
     if (res != NULL) {
         *res = stack->buffer[stack->idx];
@@ -79,127 +129,1630 @@ int prec(char oper) {
 }
 
 // Calculate operator with given operands.
+// Arithmetic wraps around in two's complement,
+// division and remainder by zero give 0 instead of trapping.
 int operate(char oper, int n1, int n2) {
     switch (oper) {
     case '*':
-        return n1 * n2;
+        return (int)((unsigned int)n1 * (unsigned int)n2);
     case '/':
-        return n1 / n2;
+        if (n2 == 0) {
+            return 0;
+        }
+        return n2 == -1 ? (int)(0u - (unsigned int)n1) : n1 / n2;
     case '%':
+        if (n2 == 0 || n2 == -1) {
+            return 0;
+        }
         return n1 % n2;
     case '+':
-        return n1 + n2;
+        return (int)((unsigned int)n1 + (unsigned int)n2);
     case '-':
-        return n1 - n2;
+        return (int)((unsigned int)n1 - (unsigned int)n2);
     default:
         return 0;
     }
 }
 
-// Convert infix form `input` to postfix form `output`.
+// Kinds of token in expression.
+enum {
+    TOKEN_NUMBER,
+    TOKEN_VARIABLE,
+    TOKEN_OPERATOR,
+    TOKEN_OPEN,
+    TOKEN_CLOSE,
+    TOKEN_END
+};
+
+// Token of expression, `value` is the number, the variable index
+// or the operator character.
+typedef struct {
+    int type;
+    int value;
+} Token;
+
+// Growable array of tokens.
+typedef struct {
+    int size;
+    int capacity;
+    Token* tokens;
+} TokenBuffer;
+
+TokenBuffer empty_token_buffer() {
+    TokenBuffer buffer;
+    buffer.size = 0;
+    buffer.capacity = INITIAL_BUFFER_SIZE;
+    buffer.tokens = malloc(sizeof(Token) * buffer.capacity);
+    return buffer;
+}
+
+void delete_token_buffer(TokenBuffer* buffer) {
+    free(buffer->tokens);
+    buffer->tokens = NULL;
+    buffer->size = 0;
+}
+
+// Append token of `type` and `value`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Buffer could not grow.
+int push_token(TokenBuffer* buffer, int type, int value) {
+    if (buffer->size >= buffer->capacity) {
+        Token* tokens = realloc(buffer->tokens, sizeof(Token) * buffer->capacity * 2);
+        if (tokens == NULL) {
+            return 0;
+        }
+        buffer->tokens = tokens;
+        buffer->capacity *= 2;
+    }
+    buffer->tokens[buffer->size].type = type;
+    buffer->tokens[buffer->size].value = value;
+    ++buffer->size;
+    return 1;
+}
+
+// Cursor over expressions of a text buffer.
+typedef struct {
+    const char* cur;
+    const char* end;
+} Scanner;
+
+Scanner make_scanner(const char* data, size_t size) {
+    Scanner scanner;
+    scanner.cur = data;
+    scanner.end = data + size;
+    return scanner;
+}
+
+void scan_space(Scanner* scanner) {
+    while (scanner->cur < scanner->end && (unsigned char)*scanner->cur <= ' ') {
+        ++scanner->cur;
+    }
+}
+
+// Read next token of `scanner` to `token`, spaces are skipped.
+// Numbers are read in all their digits, '#' ends an expression.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     No more input.
+int scan_token(Scanner* scanner, Token* token) {
+    scan_space(scanner);
+    if (scanner->cur == scanner->end) {
+        return 0;
+    }
+
+    char c = *scanner->cur++;
+    unsigned int digit = (unsigned char)c - '0';
+    if (digit < 10) {
+        unsigned int value = digit;
+        while (scanner->cur < scanner->end && (digit = (unsigned char)*scanner->cur - '0') < 10) {
+            value = value * 10 + digit;
+            ++scanner->cur;
+        }
+        token->type = TOKEN_NUMBER;
+        token->value = (int)value;
+        return 1;
+    }
+
+    unsigned int letter = ((unsigned char)c | 0x20) - 'a';
+    if (letter < N_VARIABLE) {
+        token->type = TOKEN_VARIABLE;
+        token->value = (int)letter;
+        return 1;
+    }
+
+    switch (c) {
+    case '(':
+        token->type = TOKEN_OPEN;
+        break;
+    case ')':
+        token->type = TOKEN_CLOSE;
+        break;
+    case '#':
+        token->type = TOKEN_END;
+        break;
+    default:
+        token->type = TOKEN_OPERATOR;
+        break;
+    }
+    token->value = c;
+    return 1;
+}
+
+// Convert infix form of next expression in `input` to postfix form `output`.
+// Operators wait on `oper_stack`, which is reused between expressions.
 // Condition:
-//     #-terminated string `input`
-int make_postfix(char* output, char* input) {
+//     #-terminated expression, or the rest of input.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     No more expression in input.
+int make_postfix(TokenBuffer* output, Stack* oper_stack, Scanner* input) {
     int res;
+    int n_token = 0;
+    Token token;
 
-    int i = -1;
-    int idx = 0;
-
-    Stack oper_stack = empty_stack();
+    output->size = 0;
+    oper_stack->idx = 0;
 
-    // #-terminated string
-    while (input[++i] != '#') {
-        // If digit
-        if (input[i] >= '0' && input[i] <= '9') {
-            output[idx++] = input[i];
+    // #-terminated expression
+    while (scan_token(input, &token)) {
+        ++n_token;
+        if (token.type == TOKEN_END) {
+            break;
         }
+
+        switch (token.type) {
+        // If number or variable
+        case TOKEN_NUMBER:
+        case TOKEN_VARIABLE:
+            push_token(output, token.type, token.value);
+            break;
         // If open parenthesis
-        else if (input[i] == '(') {
-            push(&oper_stack, '(');
-        }
+        case TOKEN_OPEN:
+            push(oper_stack, '(');
+            break;
         // If close parenthesis
-        else if (input[i] == ')') {
+        case TOKEN_CLOSE:
             // Until finding open parenthesis
-            while (top(&oper_stack) != '(') {
-                output[idx++] = top(&oper_stack);
-                pop(&oper_stack, NULL);
+            while (!empty(oper_stack) && top(oper_stack) != '(') {
+                pop(oper_stack, &res);
+                push_token(output, TOKEN_OPERATOR, res);
             }
             // Pop open parenthesis
-            pop(&oper_stack, NULL);
+            pop(oper_stack, NULL);
+            break;
+        // If operator, pop until lower precedence operator appears
+        default:
+            while (!empty(oper_stack) && prec(top(oper_stack)) >= prec(token.value)) {
+                pop(oper_stack, &res);
+                push_token(output, TOKEN_OPERATOR, res);
+            }
+            push(oper_stack, token.value);
+            break;
         }
-        // If stack is empty
-        // If precedence of top operator is lower than current operator.
-        else if (empty(&oper_stack) || prec(top(&oper_stack)) < prec(input[i])) {
-            push(&oper_stack, input[i]);
+    }
+
+    // Clear operator stack
+    while (pop(oper_stack, &res)) {
+        if (res != '(') {
+            push_token(output, TOKEN_OPERATOR, res);
         }
-        // If precedence of top operator is higher than current operator.
+    }
+
+    return n_token > 0;
+}
+
+// Calculate postfix form `input` of `len` tokens on `num_stack`,
+// variable `i` is bound to `vars[i]`, or 0 if `vars` is NULL.
+// Missing operands are taken as 0.
+int calc_postfix(const Token* input, int len, Stack* num_stack, const int* vars) {
+    int i, n1, n2;
+    num_stack->idx = 0;
+    for (i = 0; i < len; ++i) {
+        // If number
+        if (input[i].type == TOKEN_NUMBER) {
+            push(num_stack, input[i].value);
+        }
+        // If variable
+        else if (input[i].type == TOKEN_VARIABLE) {
+            push(num_stack, vars != NULL ? vars[input[i].value] : 0);
+        }
+        // If operator
         else {
-            // Until lower precedence operator appears 
-            while (prec(top(&oper_stack)) >= prec(input[i])) {
-                pop(&oper_stack, &res);
-                output[idx++] = res;
+            n1 = n2 = 0;
+            pop(num_stack, &n2);
+            pop(num_stack, &n1);
+            push(num_stack, operate((char)input[i].value, n1, n2));
+        }
+    }
+
+    return empty(num_stack) ? 0 : top(num_stack);
+}
+
+// Apply operator `oper` on top two numbers of `num_stack`.
+// Missing operands are taken as 0.
+void reduce(Stack* num_stack, char oper) {
+    int n1 = 0, n2 = 0;
+    pop(num_stack, &n2);
+    pop(num_stack, &n1);
+    push(num_stack, operate(oper, n1, n2));
+}
+
+// Evaluate next expression of `input` in a single pass, without postfix form.
+// Operators are applied on `num_stack` at the point `make_postfix` would write them,
+// so the result is the same as `calc_postfix` on its postfix form.
+// Result is left on top of `num_stack`, which stays empty if postfix form would be.
+// Operators wait on `oper_stack`, both stacks are reused between expressions.
+// Variable `i` is bound to `vars[i]`, or 0 if `vars` is NULL.
+// Condition:
+//     #-terminated expression, or the rest of input.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     No more expression in input.
+int eval_infix(Scanner* input, Stack* oper_stack, Stack* num_stack, const int* vars) {
+    int res;
+    int n_token = 0;
+    Token token;
+
+    oper_stack->idx = 0;
+    num_stack->idx = 0;
+
+    // #-terminated expression
+    while (scan_token(input, &token)) {
+        ++n_token;
+        if (token.type == TOKEN_END) {
+            break;
+        }
+
+        switch (token.type) {
+        case TOKEN_NUMBER:
+            push(num_stack, token.value);
+            break;
+        case TOKEN_VARIABLE:
+            push(num_stack, vars != NULL ? vars[token.value] : 0);
+            break;
+        case TOKEN_OPEN:
+            push(oper_stack, '(');
+            break;
+        case TOKEN_CLOSE:
+            while (!empty(oper_stack) && top(oper_stack) != '(') {
+                pop(oper_stack, &res);
+                reduce(num_stack, (char)res);
             }
-            push(&oper_stack, input[i]);
+            pop(oper_stack, NULL);
+            break;
+        default:
+            while (!empty(oper_stack) && prec(top(oper_stack)) >= prec(token.value)) {
+                pop(oper_stack, &res);
+                reduce(num_stack, (char)res);
+            }
+            push(oper_stack, token.value);
+            break;
         }
     }
 
-    // Clear operator stack
-    while (!empty(&oper_stack)) {
-        pop(&oper_stack, &res);
-        output[idx++] = res;
+    while (pop(oper_stack, &res)) {
+        if (res != '(') {
+            reduce(num_stack, (char)res);
+        }
     }
 
+    return n_token > 0;
+}
+
+// Write postfix form `input` of `len` tokens.
+// Single digit numbers are written back to back as in "4736%+*",
+// if any number is longer all tokens are separated by space.
+void write_postfix(FILE* output, const Token* input, int len) {
+    int i;
+    int compact = 1;
+    for (i = 0; i < len; ++i) {
+        if (input[i].type == TOKEN_NUMBER && (unsigned int)input[i].value > 9) {
+            compact = 0;
+        }
+    }
+
+    for (i = 0; i < len; ++i) {
+        if (!compact && i > 0) {
+            fputc(' ', output);
+        }
+        if (input[i].type == TOKEN_NUMBER) {
+            fprintf(output, "%d", input[i].value);
+        } else if (input[i].type == TOKEN_VARIABLE) {
+            fputc('a' + input[i].value, output);
+        } else {
+            fputc(input[i].value, output);
+        }
+    }
+}
+
+// Kinds of instruction operand.
+enum {
+    OPERAND_CONSTANT,
+    OPERAND_VARIABLE,
+    OPERAND_REGISTER
+};
+
+// Operand of instruction, `value` is the constant, the variable or the register.
+// Constants own broadcast column `slot` while running.
+typedef struct {
+    int kind;
+    int value;
+    int slot;
+} Operand;
+
+// Register instruction `dst = lhs oper rhs` over columns.
+typedef struct {
+    char oper;
+    int dst;
+    Operand lhs, rhs;
+} Instruction;
+
+// Register program compiled from postfix form.
+// Register of a value is its depth on the evaluation stack,
+// so `n_register` is the deepest stack that needs one.
+typedef struct {
+    int n_code;
+    int capacity;
+    Instruction* code;
+    int n_register;
+    int n_constant;
+    Operand result;
+} Program;
+
+Program empty_program() {
+    Program program;
+    program.n_code = 0;
+    program.capacity = INITIAL_BUFFER_SIZE;
+    program.code = malloc(sizeof(Instruction) * program.capacity);
+    program.n_register = 0;
+    program.n_constant = 0;
+    program.result.kind = OPERAND_CONSTANT;
+    program.result.value = 0;
+    program.result.slot = -1;
+    return program;
+}
+
+void delete_program(Program* program) {
+    free(program->code);
+    program->code = NULL;
+    program->n_code = 0;
+}
+
+// Append instruction `dst = lhs oper rhs`, constants get their broadcast slots.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Program could not grow.
+int emit(Program* program, char oper, int dst, Operand lhs, Operand rhs) {
+    if (program->n_code >= program->capacity) {
+        Instruction* code = realloc(program->code, sizeof(Instruction) * program->capacity * 2);
+        if (code == NULL) {
+            return 0;
+        }
+        program->code = code;
+        program->capacity *= 2;
+    }
+    if (lhs.kind == OPERAND_CONSTANT) {
+        lhs.slot = program->n_constant++;
+    }
+    if (rhs.kind == OPERAND_CONSTANT) {
+        rhs.slot = program->n_constant++;
+    }
+
+    Instruction* inst = &program->code[program->n_code++];
+    inst->oper = oper;
+    inst->dst = dst;
+    inst->lhs = lhs;
+    inst->rhs = rhs;
+    if (dst >= program->n_register) {
+        program->n_register = dst + 1;
+    }
+    return 1;
+}
+
+// Compile postfix form `input` of `len` tokens to `program`.
+// Operators on two constants are folded at compile time.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Malformed postfix form, an operator misses its operands or values are left over.
+int compile_postfix(Program* program, const Token* input, int len) {
+    int i;
+    int depth = 0;
+    int ok = 1;
+    Operand* stack = malloc(sizeof(Operand) * (len + 1));
+
+    program->n_code = 0;
+    program->n_register = 0;
+    program->n_constant = 0;
+    for (i = 0; i < len && ok; ++i) {
+        Operand operand;
+        operand.slot = -1;
+        operand.value = input[i].value;
+        switch (input[i].type) {
+        case TOKEN_NUMBER:
+            operand.kind = OPERAND_CONSTANT;
+            stack[depth++] = operand;
+            break;
+        case TOKEN_VARIABLE:
+            operand.kind = OPERAND_VARIABLE;
+            stack[depth++] = operand;
+            break;
+        default:
+            if (depth < 2) {
+                ok = 0;
+                break;
+            }
+            Operand rhs = stack[--depth];
+            Operand lhs = stack[--depth];
+            if (lhs.kind == OPERAND_CONSTANT && rhs.kind == OPERAND_CONSTANT) {
+                operand.kind = OPERAND_CONSTANT;
+                operand.value = operate((char)input[i].value, lhs.value, rhs.value);
+            } else {
+                operand.kind = OPERAND_REGISTER;
+                operand.value = depth;
+                ok = emit(program, (char)input[i].value, depth, lhs, rhs);
+            }
+            stack[depth++] = operand;
+            break;
+        }
+    }
+
+    ok = ok && depth == 1;
+    if (ok) {
+        program->result = stack[0];
+    }
+    free(stack);
+    return ok;
+}
+
+// Apply `oper` on columns `lhs` and `rhs` of `n` rows to `dst`, as `operate` row by row.
+// `dst` may be the same column as an operand.
+void scalar_kernel(char oper, int* dst, const int* lhs, const int* rhs, int n) {
+    int i;
+    switch (oper) {
+    case '+':
+        for (i = 0; i < n; ++i) {
+            dst[i] = (int)((unsigned int)lhs[i] + (unsigned int)rhs[i]);
+        }
+        break;
+    case '-':
+        for (i = 0; i < n; ++i) {
+            dst[i] = (int)((unsigned int)lhs[i] - (unsigned int)rhs[i]);
+        }
+        break;
+    case '*':
+        for (i = 0; i < n; ++i) {
+            dst[i] = (int)((unsigned int)lhs[i] * (unsigned int)rhs[i]);
+        }
+        break;
+    default:
+        for (i = 0; i < n; ++i) {
+            dst[i] = operate(oper, lhs[i], rhs[i]);
+        }
+        break;
+    }
+}
+
+// Kernel applying `oper` on columns `lhs` and `rhs` of `n` rows to `dst`.
+typedef void (*ColumnKernel)(char oper, int* dst, const int* lhs, const int* rhs, int n);
+
+// Kernel calling `operate` row by row, the reference for other kernels.
+void switch_kernel(char oper, int* dst, const int* lhs, const int* rhs, int n) {
+    int i;
+    for (i = 0; i < n; ++i) {
+        dst[i] = operate(oper, lhs[i], rhs[i]);
+    }
+}
+
+#ifdef COLUMN_KERNEL_SIMD
+typedef int v8si __attribute__((vector_size(VECTOR_LANES * sizeof(int))));
+typedef unsigned int v8su __attribute__((vector_size(VECTOR_LANES * sizeof(int))));
+
+static const v8si VEC_ONES = { 1, 1, 1, 1, 1, 1, 1, 1 };
+
+// Apply `oper` on whole vectors of columns, rest of rows goes to `scalar_kernel`.
+// Division and remainder run on a safe divisor of 1 in lanes dividing by 0 or -1,
+// those lanes are fixed up by mask afterwards, so no lane traps or branches.
+static inline __attribute__((always_inline)) void vec_kernel(
+        char oper, int* dst, const int* lhs, const int* rhs, int n) {
+    int i;
+    int n_vec = n - n % VECTOR_LANES;
+    v8si a, b, r, zero, minus;
+    for (i = 0; i < n_vec; i += VECTOR_LANES) {
+        memcpy(&a, lhs + i, sizeof(v8si));
+        memcpy(&b, rhs + i, sizeof(v8si));
+        switch (oper) {
+        case '+':
+            r = (v8si)((v8su)a + (v8su)b);
+            break;
+        case '-':
+            r = (v8si)((v8su)a - (v8su)b);
+            break;
+        case '*':
+            r = (v8si)((v8su)a * (v8su)b);
+            break;
+        case '/':
+            zero = b == 0;
+            minus = b == -1;
+            b = (b & ~(zero | minus)) | (VEC_ONES & (zero | minus));
+            // x / -1 is x negated in lanes of `minus`, as (x ^ -1) + 1.
+            r = (v8si)(((v8su)(a / b) ^ (v8su)minus) - (v8su)minus);
+            r &= ~zero;
+            break;
+        case '%':
+            zero = b == 0;
+            minus = b == -1;
+            b = (b & ~(zero | minus)) | (VEC_ONES & (zero | minus));
+            r = (a % b) & ~(zero | minus);
+            break;
+        default:
+            r = a ^ a;
+            break;
+        }
+        memcpy(dst + i, &r, sizeof(v8si));
+    }
+    scalar_kernel(oper, dst + n_vec, lhs + n_vec, rhs + n_vec, n - n_vec);
+}
+
+__attribute__((target("avx2"))) void avx2_kernel(char oper, int* dst, const int* lhs, const int* rhs, int n) {
+    vec_kernel(oper, dst, lhs, rhs, n);
+}
+
+__attribute__((target("sse4.1"))) void sse41_kernel(char oper, int* dst, const int* lhs, const int* rhs, int n) {
+    vec_kernel(oper, dst, lhs, rhs, n);
+}
+#endif
+
+// Named column kernel.
+typedef struct {
+    const char* name;
+    ColumnKernel kernel;
+} NamedColumnKernel;
+
+// Kernels in order of preference.
+NamedColumnKernel column_kernels[] = {
+#ifdef COLUMN_KERNEL_SIMD
+    { "avx2", avx2_kernel },
+    { "sse4.1", sse41_kernel },
+#endif
+    { "scalar", scalar_kernel },
+    { "switch", switch_kernel },
+};
+
+#define N_COLUMN_KERNELS \
+    ((int)(sizeof(column_kernels) / sizeof(NamedColumnKernel)))
+
+// Validate if CPU supports kernel `name`.
+int column_kernel_supported(const char* name) {
+#ifdef COLUMN_KERNEL_SIMD
+    __builtin_cpu_init();
+    if (!strcmp(name, "avx2")) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (!strcmp(name, "sse4.1")) {
+        return __builtin_cpu_supports("sse4.1");
+    }
+#endif
+    return !strcmp(name, "scalar") || !strcmp(name, "switch");
+}
+
+// Column of `operand` for batch starting at `row`.
+const int* operand_column(const Program* program, int* scratch, const int* const* columns,
+                          Operand operand, int row) {
+    switch (operand.kind) {
+    case OPERAND_CONSTANT:
+        return scratch + (size_t)(program->n_register + operand.slot) * BATCH_ROWS;
+    case OPERAND_VARIABLE:
+        return columns[operand.value] + row;
+    default:
+        return scratch + (size_t)operand.value * BATCH_ROWS;
+    }
+}
+
+// Run `program` over `n_row` rows of variable `columns` to `result`,
+// BATCH_ROWS rows at a time, one `kernel` call per instruction over the whole batch.
+// Columns of unused variables may be NULL.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Register memory could not be allocated.
+int run_program(const Program* program, ColumnKernel kernel,
+                const int* const* columns, int n_row, int* result) {
+    int i, j, row;
+    int n_column = program->n_register + program->n_constant;
+    int* scratch = malloc(sizeof(int) * ((size_t)n_column + 1) * BATCH_ROWS);
+    if (scratch == NULL) {
+        return 0;
+    }
+
+    // Broadcast constants once, they stay over all batches.
+    for (i = 0; i < program->n_code; ++i) {
+        const Operand* operands[2] = { &program->code[i].lhs, &program->code[i].rhs };
+        for (j = 0; j < 2; ++j) {
+            if (operands[j]->kind == OPERAND_CONSTANT) {
+                int* column = scratch + (size_t)(program->n_register + operands[j]->slot) * BATCH_ROWS;
+                int k;
+                for (k = 0; k < BATCH_ROWS; ++k) {
+                    column[k] = operands[j]->value;
+                }
+            }
+        }
+    }
+
+    for (row = 0; row < n_row; row += BATCH_ROWS) {
+        int n = n_row - row < BATCH_ROWS ? n_row - row : BATCH_ROWS;
+        for (i = 0; i < program->n_code; ++i) {
+            const Instruction* inst = &program->code[i];
+            kernel(inst->oper, scratch + (size_t)inst->dst * BATCH_ROWS,
+                   operand_column(program, scratch, columns, inst->lhs, row),
+                   operand_column(program, scratch, columns, inst->rhs, row), n);
+        }
+
+        if (program->result.kind == OPERAND_CONSTANT) {
+            for (j = 0; j < n; ++j) {
+                result[row + j] = program->result.value;
+            }
+        } else {
+            memcpy(result + row, operand_column(program, scratch, columns, program->result, row), sizeof(int) * n);
+        }
+    }
+
+    free(scratch);
+    return 1;
+}
+
+// Node of expression tree. Nodes are kept in postfix order,
+// so subtree of node `i` is nodes `i - size + 1` to `i` and children come first.
+// Leaves have `oper` 0 and hold their number in `value`,
+// operators hold their result there once evaluated.
+// Parent sees `a * value + b` of its child, identity until tree contraction
+// folds raked operators into it.
+typedef struct {
+    char oper;
+    char is_left;
+    int value;
+    int lhs, rhs;
+    int parent;
+    int size;
+    unsigned int a, b;
+} TreeNode;
+
+// Expression tree built from postfix form, `root` is -1 if empty.
+typedef struct {
+    int n_node;
+    int capacity;
+    int root;
+    TreeNode* nodes;
+} ExprTree;
+
+ExprTree empty_tree() {
+    ExprTree tree;
+    tree.n_node = 0;
+    tree.capacity = INITIAL_BUFFER_SIZE;
+    tree.root = -1;
+    tree.nodes = malloc(sizeof(TreeNode) * tree.capacity);
+    return tree;
+}
+
+void delete_tree(ExprTree* tree) {
+    free(tree->nodes);
+    tree->nodes = NULL;
+    tree->n_node = 0;
+    tree->root = -1;
+}
+
+// Append node of `oper` on `lhs` and `rhs`, or leaf of `value` if `oper` is 0.
+// Returns:
+//     index of new node.
+//     -1 for failure.
+// Failure:
+//     Tree could not grow.
+int add_tree_node(ExprTree* tree, char oper, int value, int lhs, int rhs) {
+    if (tree->n_node >= tree->capacity) {
+        TreeNode* nodes = realloc(tree->nodes, sizeof(TreeNode) * tree->capacity * 2);
+        if (nodes == NULL) {
+            return -1;
+        }
+        tree->nodes = nodes;
+        tree->capacity *= 2;
+    }
+
+    int idx = tree->n_node++;
+    TreeNode* node = &tree->nodes[idx];
+    node->oper = oper;
+    node->is_left = 0;
+    node->value = value;
+    node->lhs = lhs;
+    node->rhs = rhs;
+    node->parent = -1;
+    node->size = 1;
+    node->a = 1;
+    node->b = 0;
+    if (oper) {
+        node->size += tree->nodes[lhs].size + tree->nodes[rhs].size;
+        tree->nodes[lhs].parent = idx;
+        tree->nodes[lhs].is_left = 1;
+        tree->nodes[rhs].parent = idx;
+    }
     return idx;
 }
 
-// Calculate postfix form `input`.
-int calc_postfix(char* input, int len) {
+// Build expression tree of postfix form `input` of `len` tokens.
+// Variable `i` is bound to `vars[i]`, or 0 if `vars` is NULL,
+// missing operands become leaves of 0 as in `calc_postfix`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Tree could not grow.
+int build_tree(ExprTree* tree, const Token* input, int len, const int* vars) {
+    int i, n1, n2, idx;
+    int ok = 1;
+    Stack roots = empty_stack();
+
+    tree->n_node = 0;
+    for (i = 0; i < len && ok; ++i) {
+        if (input[i].type == TOKEN_NUMBER) {
+            idx = add_tree_node(tree, 0, input[i].value, -1, -1);
+        } else if (input[i].type == TOKEN_VARIABLE) {
+            idx = add_tree_node(tree, 0, vars != NULL ? vars[input[i].value] : 0, -1, -1);
+        } else {
+            n1 = n2 = -1;
+            pop(&roots, &n2);
+            pop(&roots, &n1);
+            if (n2 < 0) {
+                n2 = add_tree_node(tree, 0, 0, -1, -1);
+            }
+            if (n1 < 0) {
+                n1 = add_tree_node(tree, 0, 0, -1, -1);
+            }
+            idx = n1 < 0 || n2 < 0 ? -1 : add_tree_node(tree, (char)input[i].value, 0, n1, n2);
+        }
+        ok = idx >= 0 && push(&roots, idx);
+    }
+
+    tree->root = ok && !empty(&roots) ? top(&roots) : -1;
+    if (tree->root >= 0) {
+        tree->nodes[tree->root].parent = -1;
+    }
+    delete_stack(&roots);
+    return ok;
+}
+
+// Evaluate nodes `first` to `last` in order.
+// Condition:
+//     Labels are identity, children of nodes in range are evaluated or in range.
+void eval_tree_range(TreeNode* nodes, int first, int last) {
+    int i;
+    for (i = first; i <= last; ++i) {
+        TreeNode* node = &nodes[i];
+        if (node->oper) {
+            node->value = operate(node->oper, nodes[node->lhs].value, nodes[node->rhs].value);
+        }
+    }
+}
+
+// Evaluate whole `tree` in order of nodes, as `calc_postfix`.
+int eval_tree(ExprTree* tree) {
+    if (tree->root < 0) {
+        return 0;
+    }
+    int root = tree->root;
+    eval_tree_range(tree->nodes, root - tree->nodes[root].size + 1, root);
+    return tree->nodes[root].value;
+}
+
+// Chase-Lev deque of node indices.
+// Owner pushes and pops at `bottom`, other workers steal at `top`.
+typedef struct {
+    long top;
+    long bottom;
+    long capacity;
+    int* tasks;
+    char pad[CACHE_LINE - 3 * sizeof(long) - sizeof(int*)];
+} WorkDeque;
+
+// Push `idx` to `deque`, called only by the owner.
+// Condition:
+//     Deque is not full, capacity bounds the pushes as `run_tree_node` explains.
+void push_work(WorkDeque* deque, int idx) {
+    long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->tasks[b % deque->capacity], idx, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELEASE);
+}
+
+// Pop latest index of `deque` to `res`, called only by the owner.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Deque is empty, or its last index is stolen.
+int pop_work(WorkDeque* deque, int* res) {
+    long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    *res = __atomic_load_n(&deque->tasks[b % deque->capacity], __ATOMIC_RELAXED);
+    if (t < b) {
+        return 1;
+    }
+
+    // Last index, race with thieves for it.
+    int ok = __atomic_compare_exchange_n(&deque->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    return ok;
+}
+
+// Steal oldest index of `deque` to `res`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Deque is empty, or another worker won the index.
+int steal_work(WorkDeque* deque, int* res) {
+    long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return 0;
+    }
+
+    *res = __atomic_load_n(&deque->tasks[t % deque->capacity], __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(&deque->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+// Work-stealing evaluation of expression tree.
+// Subtrees smaller than `cutoff` are evaluated in order as one task.
+// Larger nodes count their children left to evaluate in `pending`,
+// and the child finishing last evaluates the parent.
+typedef struct {
+    TreeNode* nodes;
+    int* pending;
+    int root;
+    int cutoff;
+    int n_worker;
+    int done;
+    WorkDeque* deques;
+} TreePool;
+
+// Worker of tree pool, steals from random victims drawn from `seed`.
+typedef struct {
+    TreePool* pool;
+    int id;
+    unsigned int seed;
+    long n_steal;
+} TreeWorker;
+
+// Mark node `idx` evaluated, then evaluate ancestors whose other child is done.
+void complete_tree_node(TreePool* pool, int idx) {
+    TreeNode* nodes = pool->nodes;
+    while (idx != pool->root) {
+        int parent = nodes[idx].parent;
+        if (__atomic_sub_fetch(&pool->pending[parent], 1, __ATOMIC_ACQ_REL) != 0) {
+            return;
+        }
+        nodes[parent].value = operate(nodes[parent].oper,
+                                      nodes[nodes[parent].lhs].value,
+                                      nodes[nodes[parent].rhs].value);
+        idx = parent;
+    }
+    __atomic_store_n(&pool->done, 1, __ATOMIC_RELEASE);
+}
+
+// Evaluate subtree of `idx`, pushing smaller children not below cutoff
+// and going on with larger ones.
+// Every push leaves at least `cutoff` nodes out of the subtree going on,
+// so a deque never holds more than `n_node / cutoff` indices.
+void run_tree_node(TreeWorker* worker, int idx) {
+    TreePool* pool = worker->pool;
+    TreeNode* nodes = pool->nodes;
+
+    while (nodes[idx].oper && nodes[idx].size >= pool->cutoff) {
+        int small = nodes[idx].lhs;
+        int large = nodes[idx].rhs;
+        if (nodes[small].size > nodes[large].size) {
+            small = nodes[idx].rhs;
+            large = nodes[idx].lhs;
+        }
+
+        __atomic_store_n(&pool->pending[idx], 2, __ATOMIC_RELAXED);
+        if (nodes[small].size >= pool->cutoff) {
+            push_work(&pool->deques[worker->id], small);
+        } else {
+            eval_tree_range(nodes, small - nodes[small].size + 1, small);
+            complete_tree_node(pool, small);
+        }
+        idx = large;
+    }
+
+    eval_tree_range(nodes, idx - nodes[idx].size + 1, idx);
+    complete_tree_node(pool, idx);
+}
+
+void* tree_worker_task(void* arg) {
+    int idx;
+    TreeWorker* worker = arg;
+    TreePool* pool = worker->pool;
+
+    while (!__atomic_load_n(&pool->done, __ATOMIC_ACQUIRE)) {
+        if (pop_work(&pool->deques[worker->id], &idx)) {
+            run_tree_node(worker, idx);
+            continue;
+        }
+
+        int victim = pool->n_worker > 1 ? rand_r(&worker->seed) % (pool->n_worker - 1) : 0;
+        if (victim >= worker->id) {
+            ++victim;
+        }
+        if (victim < pool->n_worker && steal_work(&pool->deques[victim], &idx)) {
+            ++worker->n_steal;
+            run_tree_node(worker, idx);
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+// Evaluate `tree` on `n_thread` work-stealing workers,
+// subtrees smaller than `cutoff` nodes are evaluated sequentially.
+// Number of stolen tasks is stored to `n_steal` if it is not NULL.
+// Falls back to `eval_tree` if pool memory could not be allocated.
+// Returns:
+//     result of expression, 0 for empty tree.
+int eval_tree_parallel(ExprTree* tree, int n_thread, int cutoff, long* n_steal) {
+    int i;
+    if (n_steal != NULL) {
+        *n_steal = 0;
+    }
+    if (tree->root < 0) {
+        return 0;
+    }
+    if (cutoff < 1) {
+        cutoff = 1;
+    }
+    if (n_thread < 1) {
+        n_thread = 1;
+    }
+    if (n_thread > MAX_THREADS) {
+        n_thread = MAX_THREADS;
+    }
+    if (tree->nodes[tree->root].size < cutoff) {
+        return eval_tree(tree);
+    }
+
+    TreePool pool;
+    pool.nodes = tree->nodes;
+    pool.pending = malloc(sizeof(int) * tree->n_node);
+    pool.root = tree->root;
+    pool.cutoff = cutoff;
+    pool.n_worker = n_thread;
+    pool.done = 0;
+    pool.deques = malloc(sizeof(WorkDeque) * n_thread);
+    int ok = pool.pending != NULL && pool.deques != NULL;
+
+    TreeWorker workers[MAX_THREADS];
+    for (i = 0; i < n_thread && pool.deques != NULL; ++i) {
+        pool.deques[i].top = 0;
+        pool.deques[i].bottom = 0;
+        pool.deques[i].capacity = tree->n_node / cutoff + 2;
+        pool.deques[i].tasks = malloc(sizeof(int) * pool.deques[i].capacity);
+        ok = ok && pool.deques[i].tasks != NULL;
+        workers[i].pool = &pool;
+        workers[i].id = i;
+        workers[i].seed = i + 1;
+        workers[i].n_steal = 0;
+    }
+
+    // Workers only write values of operators, so `eval_tree` can take over untouched tree.
+    if (ok) {
+        push_work(&pool.deques[0], tree->root);
+        run_tasks(tree_worker_task, workers, sizeof(TreeWorker), n_thread);
+    }
+
+    for (i = 0; i < n_thread && pool.deques != NULL; ++i) {
+        if (n_steal != NULL) {
+            *n_steal += workers[i].n_steal;
+        }
+        free(pool.deques[i].tasks);
+    }
+    free(pool.deques);
+    free(pool.pending);
+    return ok ? tree->nodes[tree->root].value : eval_tree(tree);
+}
+
+// Fold leaf `leaf` and its parent into label of its sibling, parent is spliced out.
+// Operators + - * are linear in the unknown sibling over wrapping ints,
+// so they compose into the label. / and % are folded only on leaf siblings.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Leaf is root, or parent divides with operand not known yet.
+int rake(ExprTree* tree, int leaf) {
+    TreeNode* nodes = tree->nodes;
+    TreeNode* l = &nodes[leaf];
+    if (l->parent < 0) {
+        return 0;
+    }
+
+    TreeNode* p = &nodes[l->parent];
+    int sibling = l->is_left ? p->rhs : p->lhs;
+    TreeNode* s = &nodes[sibling];
+    unsigned int c = l->a * (unsigned int)l->value + l->b;
+    unsigned int a, b;
+
+    if (s->oper == 0) {
+        int y = (int)(s->a * (unsigned int)s->value + s->b);
+        int v = l->is_left ? operate(p->oper, (int)c, y) : operate(p->oper, y, (int)c);
+        s->value = (int)(p->a * (unsigned int)v + p->b);
+        s->a = 1;
+        s->b = 0;
+    } else {
+        // Parent is `a * x + b` of value `x` of sibling.
+        switch (p->oper) {
+        case '+':
+            a = s->a;
+            b = s->b + c;
+            break;
+        case '-':
+            a = l->is_left ? 0u - s->a : s->a;
+            b = l->is_left ? c - s->b : s->b - c;
+            break;
+        case '*':
+            a = c * s->a;
+            b = c * s->b;
+            break;
+        default:
+            return 0;
+        }
+        s->a = p->a * a;
+        s->b = p->a * b + p->b;
+    }
+
+    s->parent = p->parent;
+    s->is_left = p->is_left;
+    if (p->parent < 0) {
+        tree->root = sibling;
+    } else if (p->is_left) {
+        nodes[p->parent].lhs = sibling;
+    } else {
+        nodes[p->parent].rhs = sibling;
+    }
+    return 1;
+}
+
+// Task of tree contraction over leaves `begin` to `end - 1` of one round.
+// Even positions are raked, left children first and right children next,
+// no two of them are neighbours so their splices touch different nodes.
+typedef struct {
+    ExprTree* tree;
+    const int* leaves;
+    int* next;
+    char* raked;
+    int begin;
+    int end;
+    int phase;
+    int n_kept;
+} ContractTask;
+
+// Phases of contraction round.
+enum {
+    CONTRACT_LEFT,
+    CONTRACT_RIGHT,
+    CONTRACT_COMPACT
+};
+
+void* contract_task(void* arg) {
+    int i;
+    ContractTask* task = arg;
+    TreeNode* nodes = task->tree->nodes;
+
+    switch (task->phase) {
+    case CONTRACT_LEFT:
+        for (i = task->begin; i < task->end; ++i) {
+            task->raked[i] = i % 2 == 0 && nodes[task->leaves[i]].is_left
+                             && rake(task->tree, task->leaves[i]);
+        }
+        break;
+    case CONTRACT_RIGHT:
+        task->n_kept = 0;
+        for (i = task->begin; i < task->end; ++i) {
+            if (i % 2 == 0 && !task->raked[i] && !nodes[task->leaves[i]].is_left) {
+                task->raked[i] = (char)rake(task->tree, task->leaves[i]);
+            }
+            task->n_kept += !task->raked[i];
+        }
+        break;
+    default:
+        for (i = task->begin; i < task->end; ++i) {
+            if (!task->raked[i]) {
+                *task->next++ = task->leaves[i];
+            }
+        }
+        break;
+    }
+    return NULL;
+}
+
+// Run `phase` of contraction round on `n_task` tasks.
+void run_contract_phase(ContractTask* tasks, int n_task, int phase) {
+    int i;
+    for (i = 0; i < n_task; ++i) {
+        tasks[i].phase = phase;
+    }
+    if (n_task == 1) {
+        contract_task(tasks);
+    } else {
+        run_tasks(contract_task, tasks, sizeof(ContractTask), n_task);
+    }
+}
+
+// Evaluate `tree` by parallel tree contraction on `n_thread` threads.
+// Every round rakes half of leaves and splices out their parents,
+// so chains of + - * contract in a logarithmic number of rounds.
+// Rounds with fewer than `cutoff` leaves per thread use fewer threads.
+// Divisions by unknown operands may stall it, once a round rakes too few leaves
+// what is left is evaluated in order of nodes.
+// `tree` is consumed, number of rounds is stored to `n_round` if it is not NULL.
+// Falls back to `eval_tree` if leaves or round buffers could not be allocated,
+// that is checked before any leaf is raked.
+// Returns:
+//     result of expression, 0 for empty tree.
+int contract_tree(ExprTree* tree, int n_thread, int cutoff, int* n_round) {
+    int i;
+    if (n_round != NULL) {
+        *n_round = 0;
+    }
+    if (tree->root < 0) {
+        return 0;
+    }
+    if (cutoff < 1) {
+        cutoff = 1;
+    }
+    if (n_thread > MAX_THREADS) {
+        n_thread = MAX_THREADS;
+    }
+    int last = tree->root;
+    int first = last - tree->nodes[last].size + 1;
+
+    // Leaves from left to right, missing operands may break node order.
+    Stack leaves = empty_stack();
+    Stack path = empty_stack();
+    int idx = tree->root;
+    int ok = leaves.buffer != NULL && path.buffer != NULL && push(&path, idx);
+    while (ok && pop(&path, &idx)) {
+        if (tree->nodes[idx].oper) {
+            ok = push(&path, tree->nodes[idx].rhs) && push(&path, tree->nodes[idx].lhs);
+        } else {
+            ok = push(&leaves, idx);
+        }
+    }
+    delete_stack(&path);
+
+    int n_leaf = leaves.idx;
+    int* current = leaves.buffer;
+    int* next = ok ? malloc(sizeof(int) * (n_leaf + 1)) : NULL;
+    char* raked = ok ? malloc(n_leaf + 1) : NULL;
+    ContractTask tasks[MAX_THREADS];
+    // Nothing is raked yet, labels are identity and `eval_tree` still sees the whole tree.
+    // Rounds below allocate nothing, so no failure can happen once raking starts.
+    if (next == NULL || raked == NULL) {
+        free(current);
+        free(next);
+        free(raked);
+        return eval_tree(tree);
+    }
+
+    while (n_leaf > 1) {
+        int n_task = n_leaf / cutoff;
+        if (n_task > n_thread) {
+            n_task = n_thread;
+        }
+        if (n_task < 1) {
+            n_task = 1;
+        }
+        for (i = 0; i < n_task; ++i) {
+            tasks[i].tree = tree;
+            tasks[i].leaves = current;
+            tasks[i].raked = raked;
+            // Chunks start at even positions, as positions to rake.
+            tasks[i].begin = (int)((long)n_leaf * i / n_task) & ~1;
+            tasks[i].end = i + 1 == n_task ? n_leaf : (int)((long)n_leaf * (i + 1) / n_task) & ~1;
+        }
+        run_contract_phase(tasks, n_task, CONTRACT_LEFT);
+        run_contract_phase(tasks, n_task, CONTRACT_RIGHT);
+
+        int n_kept = 0;
+        for (i = 0; i < n_task; ++i) {
+            tasks[i].next = next + n_kept;
+            n_kept += tasks[i].n_kept;
+        }
+        run_contract_phase(tasks, n_task, CONTRACT_COMPACT);
+
+        int* tmp = current;
+        current = next;
+        next = tmp;
+        if (n_round != NULL) {
+            ++*n_round;
+        }
+        if (n_kept == n_leaf || n_leaf - n_kept < n_leaf / CONTRACT_STALL) {
+            n_leaf = n_kept;
+            break;
+        }
+        n_leaf = n_kept;
+    }
+
+    // Stuck on divisions, children still come before parents
+    // and nodes spliced out are never read again.
+    if (n_leaf > 1) {
+        TreeNode* nodes = tree->nodes;
+        for (i = first; i <= last; ++i) {
+            TreeNode* node = &nodes[i];
+            if (node->oper) {
+                node->value = operate(node->oper,
+                                      (int)(nodes[node->lhs].a * (unsigned int)nodes[node->lhs].value + nodes[node->lhs].b),
+                                      (int)(nodes[node->rhs].a * (unsigned int)nodes[node->rhs].value + nodes[node->rhs].b));
+            }
+        }
+    }
+
+    TreeNode* root = &tree->nodes[tree->root];
+    int result = (int)(root->a * (unsigned int)root->value + root->b);
+    free(current);
+    free(next);
+    free(raked);
+    return result;
+}
+
+double elapsed(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Evaluate every #-terminated expression of `input` and write results line by line.
+// Expressions are evaluated in a single pass and stacks are reused,
+// so no allocation happens once they have grown.
+// Returns:
+//     number of evaluated expressions.
+int stream_expressions(Scanner* input, OutputBuffer* output) {
+    int n_expr = 0;
+    Stack oper_stack = empty_stack();
     Stack num_stack = empty_stack();
 
-    int i, n1, n2;
-    for (i = 0; i < len; ++i) {
-        // If digit
-        if (input[i] >= '0' && input[i] <= '9') {
-            push(&num_stack, input[i] - '0');
+    while (eval_infix(input, &oper_stack, &num_stack, NULL)) {
+        if (empty(&num_stack)) {
+            continue;
         }
-        // If operator
-        else {
-            pop(&num_stack, &n2);
-            pop(&num_stack, &n1);
-            push(&num_stack, operate(input[i], n1, n2));
+        write_int(output, top(&num_stack), '\n');
+        ++n_expr;
+    }
+
+    delete_stack(&oper_stack);
+    delete_stack(&num_stack);
+    return n_expr;
+}
+
+// Evaluate every expression of `input` with `make_postfix` and `calc_postfix`,
+// then again with single pass `eval_infix`, and report time of both.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Results of two passes differ.
+int compare_evaluators(Scanner input, FILE* output) {
+    int i;
+    int n_mismatch = 0;
+    Scanner again = input;
+    long n_byte = (long)(input.end - input.cur);
+    TokenBuffer postfix = empty_token_buffer();
+    Stack oper_stack = empty_stack();
+    Stack num_stack = empty_stack();
+    Stack results = empty_stack();
+
+    clock_t start = clock();
+    while (make_postfix(&postfix, &oper_stack, &input)) {
+        if (postfix.size > 0) {
+            push(&results, calc_postfix(postfix.tokens, postfix.size, &num_stack, NULL));
+        }
+    }
+    double t_two_pass = elapsed(start);
+
+    i = 0;
+    start = clock();
+    while (eval_infix(&again, &oper_stack, &num_stack, NULL)) {
+        if (!empty(&num_stack)) {
+            n_mismatch += i >= results.idx || results.buffer[i] != top(&num_stack);
+            ++i;
+        }
+    }
+    double t_single_pass = elapsed(start);
+    n_mismatch += i != results.idx;
+
+    fprintf(output, "%d expressions, %ld bytes\n", results.idx, n_byte);
+    fprintf(output, "%-12s %10s\n", "mode", "time(s)");
+    fprintf(output, "%-12s %10.3f\n", "two pass", t_two_pass);
+    fprintf(output, "%-12s %10.3f\n", "single pass", t_single_pass);
+    fprintf(output, "%d mismatches\n", n_mismatch);
+
+    delete_token_buffer(&postfix);
+    delete_stack(&oper_stack);
+    delete_stack(&num_stack);
+    delete_stack(&results);
+    return n_mismatch == 0;
+}
+
+// Evaluate `postfix` over `n_row` rows of random variable values,
+// row by row with `calc_postfix` and as compiled program over columns
+// on every column kernel the CPU supports.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Expression does not compile or results differ.
+int benchmark_program(const TokenBuffer* postfix, int n_row, FILE* output) {
+    int i, v;
+    int vars[N_VARIABLE] = { 0, };
+    int* columns[N_VARIABLE] = { NULL, };
+    int* expected = malloc(sizeof(int) * (n_row + 1));
+    int* result = malloc(sizeof(int) * (n_row + 1));
+
+    // Columns of used variables, small values keep products in range.
+    srand(1);
+    for (i = 0; i < postfix->size; ++i) {
+        v = postfix->tokens[i].value;
+        if (postfix->tokens[i].type == TOKEN_VARIABLE && columns[v] == NULL) {
+            columns[v] = malloc(sizeof(int) * (n_row + 1));
+            int row;
+            for (row = 0; row < n_row; ++row) {
+                columns[v][row] = rand() % 2001 - 1000;
+            }
+        }
+    }
+
+    Program program = empty_program();
+    if (!compile_postfix(&program, postfix->tokens, postfix->size)) {
+        fprintf(output, "malformed expression\n");
+        delete_program(&program);
+        for (v = 0; v < N_VARIABLE; ++v) {
+            free(columns[v]);
         }
+        free(expected);
+        free(result);
+        return 0;
+    }
+
+    int n_operator = 0;
+    for (i = 0; i < postfix->size; ++i) {
+        n_operator += postfix->tokens[i].type == TOKEN_OPERATOR;
+    }
+    fprintf(output, "%d operators, %d instructions, %d registers, %d constants\n",
+            n_operator, program.n_code, program.n_register, program.n_constant);
+
+    Stack num_stack = empty_stack();
+    clock_t start = clock();
+    for (i = 0; i < n_row; ++i) {
+        for (v = 0; v < N_VARIABLE; ++v) {
+            if (columns[v] != NULL) {
+                vars[v] = columns[v][i];
+            }
+        }
+        expected[i] = calc_postfix(postfix->tokens, postfix->size, &num_stack, vars);
+    }
+    double t = elapsed(start);
+
+    fprintf(output, "%-12s %14s %10s %10s\n", "mode", "rows/s", "time(s)", "mismatch");
+    fprintf(output, "%-12s %14.0f %10.3f %10d\n", "calc_postfix", n_row / (t > 0 ? t : 1e-9), t, 0);
+
+    // Compiled program on every supported column kernel.
+    int n_mismatch = 0;
+    int k;
+    for (k = 0; k < N_COLUMN_KERNELS; ++k) {
+        if (!column_kernel_supported(column_kernels[k].name)) {
+            continue;
+        }
+        start = clock();
+        run_program(&program, column_kernels[k].kernel, (const int* const*)columns, n_row, result);
+        t = elapsed(start);
+
+        int mismatch = 0;
+        for (i = 0; i < n_row; ++i) {
+            mismatch += expected[i] != result[i];
+        }
+        fprintf(output, "%-12s %14.0f %10.3f %10d\n", column_kernels[k].name, n_row / (t > 0 ? t : 1e-9), t, mismatch);
+        n_mismatch += mismatch;
+    }
+
+    delete_stack(&num_stack);
+    delete_program(&program);
+    for (v = 0; v < N_VARIABLE; ++v) {
+        free(columns[v]);
+    }
+    free(expected);
+    free(result);
+    return n_mismatch == 0;
+}
+
+// Evaluate `postfix` as expression tree in order of nodes, on work-stealing pool
+// of `n_thread` workers and by tree contraction, each against `calc_postfix`.
+// Returns:
+//     1 for success.
+//     0 for failure.
+// Failure:
+//     Tree could not be built or results differ.
+int benchmark_tree(const TokenBuffer* postfix, int n_thread, int cutoff, FILE* output) {
+    int result, n_round;
+    long n_steal;
+    int n_mismatch = 0;
+
+    Stack num_stack = empty_stack();
+    double start = wall_time();
+    int expected = calc_postfix(postfix->tokens, postfix->size, &num_stack, NULL);
+    double t = wall_time() - start;
+    delete_stack(&num_stack);
+
+    ExprTree tree = empty_tree();
+    start = wall_time();
+    if (!build_tree(&tree, postfix->tokens, postfix->size, NULL)) {
+        fprintf(output, "tree could not be built\n");
+        delete_tree(&tree);
+        return 0;
     }
+    fprintf(output, "%d nodes, %d threads, cutoff %d, built in %.3fs\n",
+            tree.n_node, n_thread, cutoff, wall_time() - start);
+    fprintf(output, "%-12s %10s %12s\n", "mode", "time(s)", "result");
+    fprintf(output, "%-12s %10.3f %12d\n", "calc_postfix", t, expected);
 
-    return top(&num_stack);
+    start = wall_time();
+    result = eval_tree(&tree);
+    t = wall_time() - start;
+    fprintf(output, "%-12s %10.3f %12d\n", "sequential", t, result);
+    n_mismatch += result != expected;
+
+    // Pool writes only values of operators, leaves and structure stay for contraction.
+    start = wall_time();
+    result = eval_tree_parallel(&tree, n_thread, cutoff, &n_steal);
+    t = wall_time() - start;
+    fprintf(output, "%-12s %10.3f %12d %ld steals\n", "pool", t, result, n_steal);
+    n_mismatch += result != expected;
+
+    start = wall_time();
+    result = contract_tree(&tree, n_thread, cutoff, &n_round);
+    t = wall_time() - start;
+    fprintf(output, "%-12s %10.3f %12d %d rounds\n", "contraction", t, result, n_round);
+    n_mismatch += result != expected;
+
+    fprintf(output, "%d mismatches\n", n_mismatch);
+    delete_tree(&tree);
+    return n_mismatch == 0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Usage:
+    //     -stream: evaluate every expression of input.txt, one result per line,
+    //              and report throughput.
+    //     -batch <n_row>: compile expression of input.txt with variables a-z
+    //                     and evaluate it over `n_row` random rows.
+    //     -compare: evaluate input.txt with postfix form and in a single pass,
+    //               and report time of both.
+    //     -tree [n_thread [cutoff]]: evaluate expression of input.txt as expression tree,
+    //                                on work-stealing threads and by tree contraction.
+    int stream = argc == 2 && !strcmp(argv[1], "-stream");
+
     // Prepare for file I/O.
-    FILE* input = fopen("input.txt", "r");
-    FILE* output = fopen("output.txt", "w");
+    FileBuffer file;
+    if (!load_file(&file, "input.txt")) {
+        return 1;
+    }
+    Scanner input = make_scanner(file.data, file.size);
 
-    char infix[MAX_BUFFER_SIZE + 1] = { 0, };
-    fscanf(input, "%s", infix);
+    if (argc == 3 && !strcmp(argv[1], "-batch")) {
+        TokenBuffer postfix = empty_token_buffer();
+        Stack oper_stack = empty_stack();
+        make_postfix(&postfix, &oper_stack, &input);
+        int ok = benchmark_program(&postfix, atoi(argv[2]), stdout);
 
-    // Convert to postfix form.
-    char postfix[MAX_BUFFER_SIZE + 1] = { 0, };
-    int size = make_postfix(postfix, infix);
+        delete_token_buffer(&postfix);
+        delete_stack(&oper_stack);
+        unload_file(&file);
+        return ok ? 0 : 1;
+    }
 
-    // Calculate postfix form.
-    int result = calc_postfix(postfix, size);
+    if (argc >= 2 && argc <= 4 && !strcmp(argv[1], "-tree")) {
+        int n_thread = argc >= 3 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int cutoff = argc == 4 ? atoi(argv[3]) : TREE_CUTOFF;
+        if (n_thread < 1) {
+            n_thread = 1;
+        }
+        if (n_thread > MAX_THREADS) {
+            n_thread = MAX_THREADS;
+        }
+
+        TokenBuffer postfix = empty_token_buffer();
+        Stack oper_stack = empty_stack();
+        make_postfix(&postfix, &oper_stack, &input);
+        int ok = benchmark_tree(&postfix, n_thread, cutoff, stdout);
+
+        delete_token_buffer(&postfix);
+        delete_stack(&oper_stack);
+        unload_file(&file);
+        return ok ? 0 : 1;
+    }
+
+    if (argc == 2 && !strcmp(argv[1], "-compare")) {
+        int ok = compare_evaluators(input, stdout);
+        unload_file(&file);
+        return ok ? 0 : 1;
+    }
 
-    // Convert #-terminated string to NULL-terminated string
-    int idx = -1;
-    while (infix[++idx] != '#');
-    infix[idx] = 0;
+    if (stream) {
+        OutputBuffer* output = malloc(sizeof(OutputBuffer));
+        output->fp = fopen("output.txt", "w");
+        output->size = 0;
+
+        clock_t start = clock();
+        int n_expr = stream_expressions(&input, output);
+        flush_output(output);
+        double t = elapsed(start);
+        printf("%d expressions, %.3fs, %.0f expressions/s\n", n_expr, t, t > 0 ? n_expr / t : 0.0);
+
+        fclose(output->fp);
+        free(output);
+        unload_file(&file);
+        return 0;
+    }
+
+    FILE* output = fopen("output.txt", "w");
+
+    // Infix form is the text up to '#'.
+    scan_space(&input);
+    const char* infix = input.cur;
+    const char* infix_end = memchr(infix, '#', input.end - infix);
+    if (infix_end == NULL) {
+        infix_end = input.end;
+    }
+
+    // Evaluate in a single pass.
+    Scanner expr = input;
+    Stack oper_stack = empty_stack();
+    Stack num_stack = empty_stack();
+    eval_infix(&input, &oper_stack, &num_stack, NULL);
+    int result = empty(&num_stack) ? 0 : top(&num_stack);
+
+    // Postfix form is built only to be written.
+    TokenBuffer postfix = empty_token_buffer();
+    make_postfix(&postfix, &oper_stack, &expr);
 
     // Log
-    fprintf(output, "Infix Form : %s\n", infix);
-    fprintf(output, "Postfix Form : %s\n", postfix);
+    fprintf(output, "Infix Form : %.*s\n", (int)(infix_end - infix), infix);
+    fprintf(output, "Postfix Form : ");
+    write_postfix(output, postfix.tokens, postfix.size);
+    fprintf(output, "\n");
     fprintf(output, "Evaluation Result : %d\n", result);
 
-    fclose(input);
+    delete_token_buffer(&postfix);
+    delete_stack(&oper_stack);
+    delete_stack(&num_stack);
+    unload_file(&file);
+
     fclose(output);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,59 @@
+// Threads of tasks and wall clock shared by every lab.
+// Every lab builds as a single translation unit, so definitions live here.
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+// Threads are optional, CI links without -lpthread.
+// Weak references resolve to NULL there, callers check `pthread_create`
+// or let `run_tasks` run tasks on the calling thread.
+#pragma weak pthread_create
+#pragma weak pthread_join
+
+// Start `n_task` tasks of `task_size` bytes each on `threads`, up to the first failure.
+// Returns:
+//     number of tasks started, 0 if threads are unavailable.
+int spawn_tasks(void* (*fn)(void*), void* tasks, size_t task_size, int n_task, pthread_t* threads) {
+    int i;
+    if (pthread_create == NULL) {
+        return 0;
+    }
+    for (i = 0; i < n_task; ++i) {
+        if (pthread_create(&threads[i], NULL, fn, (char*)tasks + task_size * i) != 0) {
+            break;
+        }
+    }
+    return i;
+}
+
+// Join first `n_thread` of `threads`.
+void join_tasks(pthread_t* threads, int n_thread) {
+    int i;
+    for (i = 0; i < n_thread; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// Run `n_task` tasks of `task_size` bytes each on their own threads.
+// Tasks that could not get a thread run on the calling thread.
+void run_tasks(void* (*fn)(void*), void* tasks, size_t task_size, int n_task) {
+    int i;
+    pthread_t* threads = malloc(sizeof(pthread_t) * (n_task + 1));
+    int n_spawned = threads != NULL ? spawn_tasks(fn, tasks, task_size, n_task, threads) : 0;
+    for (i = n_spawned; i < n_task; ++i) {
+        fn((char*)tasks + task_size * i);
+    }
+    join_tasks(threads, n_spawned);
+    free(threads);
+}
+
+double wall_time() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+#endif // TASKS_H